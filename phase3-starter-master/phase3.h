@@ -19,10 +19,135 @@
 #define P3_PAGER_PRIORITY   1
 
 /*
- * Swap disk.
+ * Priority of the process that merges duplicate pages, and a reasonable interval (in seconds)
+ * for it to run at (P3_VmOptions.dedupInterval, off by default).
+ */
+#define P3_DEDUP_PRIORITY   5
+#define P3_DEDUP_INTERVAL   1
+
+/*
+ * Priority of the process that compacts swap while the swap disks are idle, and a reasonable
+ * interval (in seconds) for it to run at (P3_VmOptions.compactInterval, off by default).
+ */
+#define P3_COMPACT_PRIORITY 5
+#define P3_COMPACT_INTERVAL 1
+
+/*
+ * Priority of the process that collects the MMU's reference bits for the clock ahead of the
+ * faults that need a frame, and a reasonable interval (in seconds) for it to run at
+ * (P3_VmOptions.harvestInterval, off by default).
+ */
+#define P3_HARVEST_PRIORITY 5
+#define P3_HARVEST_INTERVAL 1
+
+/*
+ * Priority of the process that zeroes free frames ahead of time for new pages
+ * (P3_VmOptions.zeroFrames, off by default).
+ */
+#define P3_ZERO_PRIORITY    5
+
+/*
+ * Whole-process swap-out. Once fewer than P3_SWAPOUT_FREE_PERCENT of the frames are free,
+ * a process that has been blocked without running for P3_VmOptions.swapOutIdle seconds
+ * (off by default, P3_SWAPOUT_IDLE is a reasonable value) has all its pages swapped out at
+ * once, and they are brought back in one batch on its next fault. The swapper process
+ * checks once a second.
+ */
+#define P3_SWAPOUT_PRIORITY     5
+#define P3_SWAPOUT_IDLE         2
+#define P3_SWAPOUT_FREE_PERCENT 10
+
+/*
+ * Most pages that can be pinned (P3_VmLock), as a % of the frames, so the clock always has
+ * frames to replace.
+ */
+#define P3_MAX_PINNED_PERCENT   50
+
+/*
+ * Prefetching. Once P3_PREFETCH_CONFIRM of a process's faults in a row are the same stride
+ * apart the pages the stream goes on to are brought in ahead of the faults, starting with
+ * P3_PREFETCH_MIN pages after each fault and at most P3_VmOptions.prefetch (off by default,
+ * P3_PREFETCH_MAX is a reasonable value). A process that blocks, e.g. in Sys_Sleep, also gets
+ * the pages it lost while blocked back in one batch when it wakes up.
+ */
+#define P3_PREFETCH_CONFIRM 2
+#define P3_PREFETCH_MIN     2
+#define P3_PREFETCH_MAX     8
+
+/*
+ * Inactive list. The clock unmaps pages onto it, saving them first if they are dirty, until
+ * it holds P3_inactivePercent of the frames (at least one). Their frames keep their contents,
+ * so a fault on one is a soft fault that just maps it back; the frame only goes to another
+ * page once it gets to the tail of the list. P3_inactivePercent is 0 by default, for no
+ * inactive list; P3_INACTIVE_PERCENT is a reasonable value.
+ */
+#define P3_INACTIVE_PERCENT 10
+
+/*
+ * Maximum number of shared regions (P3_VmShare).
+ */
+#define P3_MAX_REGIONS  10
+
+/*
+ * Swap disk, the default for P3_swapUnits. P3_swapUnits is a bit mask of the disk units
+ * used for swap (bit n for unit n); the swap blocks are striped across them. Set it before
+ * P3_VmInit.
  */
 #define P3_SWAP_DISK 1
 
+/*
+ * Swap disk scheduling (P3_swapSched), and the most blocks merged into one transfer.
+ */
+#define P3_SCHED_FIFO   0
+#define P3_SCHED_CSCAN  1
+#define P3_MAX_CLUSTER  8
+
+/*
+ * Statistics export formats (P3_statsFormat, P3_StatsDump). The clock interrupt handler only
+ * copies the statistics into a ring of P3_STATS_RING snapshots; a process at
+ * P3_STATS_PRIORITY writes them to P3_statsFile once a second.
+ */
+#define P3_STATS_CSV    0
+#define P3_STATS_JSON   1
+#define P3_STATS_RING   64
+#define P3_STATS_PRIORITY   2
+
+/*
+ * Options for P3_VmInitEx. P3_VmOptionsInit fills them in with the defaults, which are the
+ * values of the P3_swapUnits etc. globals below and 0 for everything else, so none of the
+ * background processes run and P3_VmInit works as it always has, changed by the environment
+ * variable P3_VM_OPTIONS if it is set. P3_VM_OPTIONS is a list of name=value, separated by spaces or
+ * commas, that P3_VmOptionsParse applies, e.g.
+ *
+ *      P3_VM_OPTIONS="swapSched=fifo swapUnits=0x6 dedupInterval=1"
+ *
+ * The names are those of the fields; swapSched also takes fifo and cscan, and statsFormat
+ * csv and json. version has to be P3_VM_OPTIONS_VERSION, which goes up when fields are
+ * added, so code built against an older phase3.h is caught.
+ */
+#define P3_VM_OPTIONS_VERSION   6
+
+typedef struct P3_VmOptions {
+    int     version;        /* P3_VM_OPTIONS_VERSION */
+    int     pages;          /* size of the VM region, in pages */
+    int     frames;         /* size of physical memory, in frames */
+    int     pagers;         /* # of pager processes */
+    int     swapUnits;      /* bit mask of the disk units used for swap */
+    int     swapSched;      /* P3_SCHED_FIFO or P3_SCHED_CSCAN */
+    int     dedupInterval;  /* seconds between dedup scans, 0 for none */
+    int     compactInterval;/* seconds between swap compactions, 0 for none */
+    int     harvestInterval;/* seconds between reference bit harvests, 0 for none */
+    int     zeroFrames;     /* TRUE to zero free frames ahead of time */
+    int     frameLimit;     /* most frames a process may have, 0 for no limit (P3_SetFrameLimit) */
+    int     prefetch;       /* most pages prefetched after a fault, 0 for no prefetching at all */
+    int     swapOutIdle;    /* seconds blocked before a process is swapped out whole, 0 for never */
+    int     inactivePercent;/* % of the frames kept on the inactive list, 0 for none */
+    char    *faultTrace;    /* file to record faults in, NULL for none */
+    char    *statsFile;     /* file to write statistics snapshots to, NULL for none */
+    int     statsFormat;    /* P3_STATS_CSV or P3_STATS_JSON */
+    int     statsInterval;  /* clock interrupts between snapshots, 0 for only at shutdown */
+} P3_VmOptions;
+
 /*
  * Paging statistics
  */
@@ -37,9 +162,55 @@ typedef struct P3_VmStats {
     int pageIns;    /* # faults that required reading page from disk */
     int pageOuts;   /* # faults that required writing a page to disk */
     int replaced;   /* # pages replaced */
+    int fillPages;  /* # pages swapped out as a fill value, without disk I/O */
+    int merged;     /* # frames freed by merging pages with identical contents */
+    int cowFaults;  /* # writes to merged pages that required a copy */
+    int ioRequests; /* # block reads and writes queued for the swap disk */
+    int ioTransfers;/* # disk operations used for them, after merging */
+    int ioSeek;     /* # tracks the swap disk head moved */
+    int ioWait;     /* total time requests spent queued and in transfer, in microseconds */
+    int compacted;  /* # blocks moved by swap compaction */
+    int fragmentation; /* % of a process's blocks not adjacent to its previous one */
+    int faultWait;  /* total time faults took to be handled, in microseconds */
+    int preZeroed;  /* # new pages given a frame that was zeroed ahead of time */
+    int zeroedInline; /* # new pages whose frame was zeroed during the fault */
+    int pinnedFrames; /* # frames holding pinned pages (P3_VmLock) */
+    int prefetched; /* # pages brought in ahead of a fault on them */
+    int prefetchWasted; /* # prefetched pages replaced before they were used */
+    int procSwapOuts; /* # times a blocked process was swapped out whole */
+    int procSwapPages; /* # pages swapped out with them */
+    int procSwapIns; /* # pages brought back in a batch when they woke up */
+    int mappedPages; /* # pages mapped to disk blocks (P3_VmMap) */
+    int mapWrites;  /* # dirty mapped pages written back when their process quit */
+    int softFaults; /* # faults on inactive pages, mapped back without I/O */
+    int hardFaults; /* # faults that needed a new frame */
+    int refaults;   /* # hard faults on pages evicted just before they were needed again */
+    int wakePrefetched; /* # pages a process lost while blocked, brought back when it woke */
+    int procSwapFails; /* # times swapping a process out whole ran out of swap */
 } P3_VmStats;
 
+/*
+ * Per-process paging statistics, indexed by pid. They are cleared when the process gets its
+ * page table and kept after it quits, until the pid is reused.
+ */
+typedef struct P3_ProcStats {
+    int faults;     /* # of page faults */
+    int newPages;   /* # faults caused by previously unused pages */
+    int pageIns;    /* # faults that required reading page from disk */
+    int pageOuts;   /* # of the process's pages written to disk */
+    int replaced;   /* # of the process's pages replaced */
+    int faultWait;  /* total time faults took to be handled, in microseconds */
+} P3_ProcStats;
+
 extern P3_VmStats P3_vmStats;
+extern int P3_swapSched;
+extern int P3_swapUnits;
+extern int P3_inactivePercent;  /* % of the frames kept on the inactive list, 0 for none */
+extern char *P3_faultTrace;     /* file to record faults in, see phase3Trace.h */
+extern P3_ProcStats P3_procStats[];
+extern char *P3_statsFile;      /* file to write statistics snapshots to, see P3_StatsDump */
+extern int P3_statsFormat;      /* P3_STATS_CSV or P3_STATS_JSON */
+extern int P3_statsInterval;    /* clock interrupts between snapshots, 0 for only at shutdown */
 
 /*
  * Error codes
@@ -59,16 +230,32 @@ extern P3_VmStats P3_vmStats;
 #define P3_INVALID_PAGE             -42
 #define P3_ACCESS_VIOLATION         -43
 #define P3_NOT_IMPLEMENTED          -44
+#define P3_INVALID_REGION           -45
+#define P3_TOO_MANY_REGIONS         -46
+#define P3_INVALID_SWAP_UNITS       -47
+#define P3_INVALID_OPTIONS          -48
+#define P3_TOO_MANY_PINNED          -49
+#define P3_INVALID_MAPPING          -50
 
 #ifndef CHECKRETURN
 #define CHECKRETURN __attribute__((warn_unused_result))
 #endif
 
 extern int          P3_VmInit(int mappings, int pages, int frames, int pagers) CHECKRETURN;
+extern int          P3_VmInitEx(P3_VmOptions *options) CHECKRETURN;
+extern void         P3_VmOptionsInit(P3_VmOptions *options);
+extern int          P3_VmOptionsParse(P3_VmOptions *options, char *list) CHECKRETURN;
 extern void         P3_VmDestroy(void);
 extern  USLOSS_PTE  *P3_AllocatePageTable(int pid) CHECKRETURN;
 extern  void        P3_FreePageTable(int pid);
 extern void         P3_PrintStats(P3_VmStats *stats);
+extern void         P3_StatsDump(FILE *file, int format);
+extern int          P3_VmShare(int pid, int page, int count, int *handle) CHECKRETURN;
+extern int          P3_VmAttach(int handle, int pid, int page) CHECKRETURN;
+extern int          P3_SetFrameLimit(int pid, int limit) CHECKRETURN;
+extern int          P3_VmLock(int pid, int page, int count) CHECKRETURN;
+extern int          P3_VmUnlock(int pid, int page, int count) CHECKRETURN;
+extern int          P3_VmMap(int pid, int page, int count, int unit, int block) CHECKRETURN;
 
 extern int  P4_Startup(void *) CHECKRETURN;
 
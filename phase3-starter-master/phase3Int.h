@@ -14,6 +14,19 @@
 
 typedef int PID;    // PID
 
+// internal return codes, never returned to user code
+#define P3_IO_PENDING   1   // swap I/O was queued, the fault is finished when it's done
+#define P3_FRAMES_BUSY  2   // every frame has I/O outstanding, retry when one is idle
+
+// tracepoints (phase3Trace.h)
+#ifdef P3_TRACEPOINTS
+void        P3Tracepoint(int event, int pid, int page, int frame, int unit, int arg);
+#define P3_TP(event, pid, page, frame, unit, arg) \
+    P3Tracepoint(event, pid, page, frame, unit, arg)
+#else
+#define P3_TP(event, pid, page, frame, unit, arg) ((void) 0)
+#endif
+
 // helpful macro
 #define CheckMode() \
     if ((USLOSS_PsrGet() & USLOSS_PSR_CURRENT_MODE) == 0) { \
@@ -26,18 +39,51 @@ typedef int PID;    // PID
 // Phase 3a
 
 int         P3PageTableGet(PID pid, USLOSS_PTE **table) CHECKRETURN;
+void        P3VmLock(void);
+void        P3VmUnlock(void);
+void        P3PageFaultDone(PID pid, int page, int frame);
+void        P3FrameIdle(void);
+void        P3FrameFreed(void);
 
 // Phase 3b
 
 int         P3FrameInit(int pages, int frames) CHECKRETURN;
 int         P3FrameFreeAll(PID pid) CHECKRETURN;
 int         P3PageFaultResolve(int pid, int page, int *frame) CHECKRETURN;
+int         P3CowFaultResolve(int pid, int page, int *frame) CHECKRETURN;
+int         P3PagePrefetch(int pid, int page, int *frame) CHECKRETURN;
+void        P3FrameFree(int frame);
+int         P3FrameZeroFree(int *zeroed) CHECKRETURN;
+void        P3FrameIoDone(int frame);
 
 // Phase 3c
 
 int         P3SwapInit(int pages, int frames) CHECKRETURN;
 int         P3SwapFreeAll(PID pid) CHECKRETURN;
-int         P3SwapOut(int *frame) CHECKRETURN;
+int         P3SwapOut(PID pid, int *frame) CHECKRETURN;
 int         P3SwapIn(PID pid, int page, int frame) CHECKRETURN;
+void        P3SwapShutdown(void);
+int         P3FrameMap(PID pid, int page, int frame) CHECKRETURN;
+int         P3FrameUnmap(PID pid, int page, int frame, int *mapped) CHECKRETURN;
+int         P3DedupScan(void) CHECKRETURN;
+int         P3SharedFrameGet(PID pid, int page, int *frame) CHECKRETURN;
+int         P3ShareCreate(PID pid, int page, int count, int *handle) CHECKRETURN;
+int         P3ShareAttach(int handle, PID pid, int page) CHECKRETURN;
+int         P3FrameZero(int frame) CHECKRETURN;
+int         P3FrameCopy(int frame, void *page) CHECKRETURN;
+int         P3SwapCompact(int *moved) CHECKRETURN;
+int         P3SwapBlock(PID pid, int page, int *block) CHECKRETURN;
+int         P3SwapFind(PID pid, int page, int *found) CHECKRETURN;
+int         P3FrameScrub(int frame) CHECKRETURN;
+int         P3AccessHarvest(void) CHECKRETURN;
+int         P3FrameLimitSet(PID pid, int limit) CHECKRETURN;
+int         P3FrameLimitReached(PID pid, int *reached) CHECKRETURN;
+int         P3FramePin(int frame, int delta) CHECKRETURN;
+int         P3ProcessSwapOut(PID pid, int *count) CHECKRETURN;
+int         P3FrameBusy(int frame, int *busy) CHECKRETURN;
+void        P3FrameFreeSet(int frame, int is_free);
+int         P3MapCreate(PID pid, int page, int count, int unit, int block) CHECKRETURN;
+int         P3MapSync(PID pid) CHECKRETURN;
+int         P3InactiveGet(PID pid, int page, int *frame) CHECKRETURN;
 
 #endif
@@ -0,0 +1,75 @@
+/*
+ * Fault trace and tracepoint records for Phase 3 of the project (virtual memory).
+ *
+ * If P3_faultTrace names a file when P3_VmInit is called, the pager appends one record to
+ * it for every fault it handles. While tracing, the pager also takes away read access to
+ * a process's previous faulting page, so the next reference to it faults too and the
+ * trace records each change of page a process makes (P3_TRACE_REF), not just its misses.
+ * The trace can then be replayed offline against other replacement policies and numbers
+ * of frames (tools/replay). Tracing adds these faults to P3_vmStats.faults.
+ *
+ * This header only uses standard types so the host-side tools can include it.
+ */
+#ifndef _PHASE3_TRACE_H
+#define _PHASE3_TRACE_H
+
+#include <stdint.h>
+
+/*
+ * Kinds of fault.
+ */
+#define P3_TRACE_FAULT  0   /* page was not in memory */
+#define P3_TRACE_WRITE  1   /* write to a read-only (copy-on-write) page */
+#define P3_TRACE_REF    2   /* first reference to an in-memory page since the previous fault */
+
+typedef struct P3_TraceRecord {
+    uint32_t    time;   /* USLOSS_Clock when the fault was handled */
+    int16_t     pid;
+    uint8_t     kind;   /* P3_TRACE_FAULT, P3_TRACE_WRITE or P3_TRACE_REF */
+    uint8_t     unused;
+    int32_t     page;
+    int32_t     frame;  /* frame the page ended up in, -1 if the process was killed */
+    int32_t     block;  /* swap block the page was kept in, -1 if none */
+} P3_TraceRecord;
+
+/*
+ * Tracepoints. If the phase is compiled with -DP3_TRACEPOINTS (see subdir.mk), each P3_TP
+ * in the code appends a record to an in-memory ring of the last P3_TP_RING records;
+ * otherwise P3_TP compiles to nothing. The ring is written to P3_TP_FILE, oldest record
+ * first, by P3_VmShutdown, at exit and on abort, and tools/tpdump decodes it.
+ */
+#define P3_TP_RING  4096
+#define P3_TP_FILE  "tracepoints.bin"
+
+/*
+ * Tracepoint events. Every record has the pid and page involved, -1 if none; frame, unit and arg
+ * are as listed, and -1 where not.
+ */
+#define P3_TP_ENQUEUE   0   /* fault queued for the pager */
+#define P3_TP_DEQUEUE   1   /* pager took the fault off the queue */
+#define P3_TP_WAKEUP    2   /* faulting process let go; frame it got, arg = result */
+#define P3_TP_VICTIM    3   /* clock picked frame, the page is the one evicted from it */
+#define P3_TP_SWAP_READ 4   /* read of the page into frame queued; unit, arg = sector */
+#define P3_TP_SWAP_WRITE 5  /* write of the page from frame queued; unit, arg = sector */
+#define P3_TP_NEW_PAGE  6   /* first use of the page, zero-filled in frame */
+#define P3_TP_COW       7   /* page copied to frame; arg = frame it was copied from */
+#define P3_TP_FILL      8   /* page in frame saved as a fill value; arg = fill */
+#define P3_TP_MOVE      9   /* compaction moved the page's block; frame = old sector, unit and
+                               arg = new unit and sector */
+#define P3_TP_MERGE     10  /* page's frame merged into another; arg = frame kept */
+#define P3_TP_PREFETCH  11  /* page brought into frame ahead of a fault; arg = result */
+#define P3_TP_DEACTIVATE 12 /* page unmapped onto the inactive list, still in frame */
+#define P3_TP_SOFT_FAULT 13 /* page on the inactive list mapped back into frame */
+#define P3_TP_EVENTS    14
+
+typedef struct P3_TpRecord {
+    uint32_t    time;   /* USLOSS_Clock */
+    uint8_t     event;  /* P3_TP_ENQUEUE ... */
+    int8_t      unit;
+    int16_t     pid;
+    int32_t     page;
+    int32_t     frame;
+    int32_t     arg;
+} P3_TpRecord;
+
+#endif
@@ -5,6 +5,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <usloss.h>
 #include <assert.h>
@@ -16,10 +17,39 @@
 
 int P3FrameInit(int pages, int frames) {return P1_SUCCESS;}
 int P3FrameFreeAll(PID pid) {return P1_SUCCESS;}
+int P3CowFaultResolve(int pid, int page, int *frame) {return P3_ACCESS_VIOLATION;}
+void P3FrameFree(int frame) {}
+int P3FrameZeroFree(int *zeroed) {*zeroed = FALSE; return P1_SUCCESS;}
+void P3FrameIoDone(int frame) {}
+int P3PagePrefetch(int pid, int page, int *frame) {return P3_NOT_IMPLEMENTED;}
 
 // Phase 3d
 
 int P3SwapInit(int pages, int frames) {return P1_SUCCESS;}
 int P3SwapFreeAll(PID pid) {return P1_SUCCESS;}
-int P3SwapOut(int *frame) {return P1_SUCCESS;}
+int P3SwapOut(PID pid, int *frame) {return P1_SUCCESS;}
 int P3SwapIn(PID pid, int page, int frame) {return P1_SUCCESS;}
+void P3SwapShutdown(void) {}
+int P3FrameMap(PID pid, int page, int frame) {return P1_SUCCESS;}
+int P3FrameUnmap(PID pid, int page, int frame, int *mapped) {*mapped = 0; return P1_SUCCESS;}
+int P3DedupScan(void) {return P1_SUCCESS;}
+int P3SharedFrameGet(PID pid, int page, int *frame) {return P3_PAGE_NOT_FOUND;}
+int P3ShareCreate(PID pid, int page, int count, int *handle) {return P3_NOT_IMPLEMENTED;}
+int P3ShareAttach(int handle, PID pid, int page) {return P3_NOT_IMPLEMENTED;}
+int P3FrameZero(int frame) {return P1_SUCCESS;}
+int P3FrameCopy(int frame, void *page) {free(page); return P1_SUCCESS;}
+int P3SwapCompact(int *moved) {*moved = FALSE; return P1_SUCCESS;}
+int P3SwapBlock(PID pid, int page, int *block) {*block = -1; return P1_SUCCESS;}
+int P3SwapFind(PID pid, int page, int *found) {*found = FALSE; return P1_SUCCESS;}
+int P3FrameScrub(int frame) {return P1_SUCCESS;}
+int P3AccessHarvest(void) {return P1_SUCCESS;}
+int P3FrameLimitSet(PID pid, int limit) {return P1_SUCCESS;}
+int P3FrameLimitReached(PID pid, int *reached) {*reached = FALSE; return P1_SUCCESS;}
+int P3FramePin(int frame, int delta) {return P1_SUCCESS;}
+int P3ProcessSwapOut(PID pid, int *count) {*count = 0; return P1_SUCCESS;}
+int P3FrameBusy(int frame, int *busy) {*busy = FALSE; return P1_SUCCESS;}
+void P3FrameFreeSet(int frame, int is_free) {}
+int P3MapCreate(PID pid, int page, int count, int unit, int block) {return P3_NOT_IMPLEMENTED;}
+int P3MapSync(PID pid) {return P1_SUCCESS;}
+int P3InactiveGet(PID pid, int page, int *frame) {return P3_PAGE_NOT_FOUND;}
+
@@ -8,11 +8,225 @@
 #include <phase2.h>
 #include <usloss.h>
 #include <string.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <errno.h>
+#include <signal.h>
 #include <libuser.h>
 
 #include "phase3Int.h"
+#include "phase3Trace.h"
 
 P3_VmStats  P3_vmStats;
+int         P3_swapUnits = 1 << P3_SWAP_DISK;
+char        *P3_faultTrace = NULL;
+P3_ProcStats    P3_procStats[P1_MAXPROC];
+char        *P3_statsFile = NULL;
+int         P3_statsFormat = P3_STATS_CSV;
+int         P3_statsInterval = 0;
+
+// A pending page fault. A process can only have one outstanding fault so there is one
+// per process slot.
+typedef struct Fault {
+    PID             pid;
+    int             page;
+    int             cause;      // USLOSS_MMU_FAULT or USLOSS_MMU_ACCESS
+    int             handled;    // pager is done with the fault
+    int             rc;         // result of resolving the fault
+    int             start;      // USLOSS_Clock when the fault happened
+    int             prefetch;   // waiting for the page's prefetch to finish
+    struct Fault    *next;
+} Fault;
+
+// A process's faults as the prefetcher sees them. Once P3_PREFETCH_CONFIRM strides in a row
+// are the same the stream is confirmed, and after each fault the next window pages the
+// stream goes on to are prefetched.
+typedef struct Stream {
+    int     last;       // page of the previous fault, -1 if none
+    int     stride;     // pages between the previous two faults
+    int     runs;       // # strides in a row that were the same
+    int     window;     // # pages prefetched after a fault
+    int     end;        // page the stream goes on to after the prefetched ones
+} Stream;
+
+static Fault        faults[P1_MAXPROC];
+static Fault        *faultHead = NULL;
+static Fault        *faultTail = NULL;
+static Fault        *busyHead = NULL;   // faults that found every frame busy with I/O
+static Fault        *busyTail = NULL;
+
+static int          faultLock;      // protects the fault queue
+static int          faultPending;   // signalled when a fault is added to the queue
+static int          faultDone;      // broadcast when a fault has been handled
+static int          vmLock;         // held while the frame and swap structures are changed
+static int          frameFreed;     // signalled when a frame is freed or its I/O is done
+static int          prefetchDone;   // broadcast when a prefetch read is done
+
+static int          vmInitialized = FALSE;
+static int          vmShutdown = FALSE;
+static int          dedupInterval;      // from P3_VmOptions
+static int          compactInterval;
+static int          harvestInterval;
+static int          frameLimit;
+static int          numPages;
+static int          pageSize;
+static char         *vmRegion;
+static char         *pinnedPages[P1_MAXPROC];   // TRUE for each of a process's pinned pages
+static int          numPinned;                  // # pages pinned by all processes
+static int          maxPinned;
+static int          prefetchMax;                // most pages prefetched after a fault
+static Stream       streams[P1_MAXPROC];
+static char         *prefetching[P1_MAXPROC];   // TRUE for each page being read in ahead
+static int          prefetchReads[P1_MAXPROC];  // # of those
+static int          swapOutIdle;                // from P3_VmOptions
+static char         *swappedSet[P1_MAXPROC];    // TRUE for each page to bring back (SetRestore)
+static int          swappedOut[P1_MAXPROC];     // TRUE if the process was swapped out whole
+static int          asleep[P1_MAXPROC];         // TRUE if its pages were recorded while blocked
+static int          idleCpu[P1_MAXPROC];        // the process's CPU time when it was last checked
+static int          idleTime[P1_MAXPROC];       // seconds it has been blocked without running
+
+static USLOSS_PTE   *pageTables[P1_MAXPROC];
+
+static FILE         *traceFile = NULL;          // open if P3_faultTrace was set
+static int          traceLast[P1_MAXPROC];      // each process's previous faulting page
+
+static FILE         *statsFile = NULL;          // open if P3_statsFile was set
+static int          statsTicks;                 // clock interrupts since the last snapshot
+static void         (*clockHandler)(int type, void *arg);  // the clock handler before ours
+
+// A copy of the statistics StatsClock takes, for StatsWriter to write.
+typedef struct StatsSnapshot {
+    int             time;
+    P3_VmStats      vm;
+    P3_ProcStats    procs[P1_MAXPROC];
+} StatsSnapshot;
+
+static StatsSnapshot statsRing[P3_STATS_RING];
+static unsigned     statsTaken;     // # of snapshots ever taken, the next goes in % P3_STATS_RING
+static unsigned     statsWritten;   // # of them written or dropped
+
+// The exported statistics, in the order they are written.
+typedef struct StatField {
+    char    *name;
+    int     offset;
+} StatField;
+
+#define STAT(type, field) { #field, offsetof(type, field) }
+#define STAT_VALUE(stats, field) (*(int *) ((char *) (stats) + (field)->offset))
+
+static StatField vmFields[] = {
+    STAT(P3_VmStats, pages), STAT(P3_VmStats, frames), STAT(P3_VmStats, blocks),
+    STAT(P3_VmStats, freeFrames), STAT(P3_VmStats, freeBlocks), STAT(P3_VmStats, faults),
+    STAT(P3_VmStats, newPages), STAT(P3_VmStats, pageIns), STAT(P3_VmStats, pageOuts),
+    STAT(P3_VmStats, replaced), STAT(P3_VmStats, fillPages), STAT(P3_VmStats, merged),
+    STAT(P3_VmStats, cowFaults), STAT(P3_VmStats, ioRequests), STAT(P3_VmStats, ioTransfers),
+    STAT(P3_VmStats, ioSeek), STAT(P3_VmStats, ioWait), STAT(P3_VmStats, compacted),
+    STAT(P3_VmStats, fragmentation), STAT(P3_VmStats, faultWait), STAT(P3_VmStats, preZeroed),
+    STAT(P3_VmStats, zeroedInline), STAT(P3_VmStats, pinnedFrames), STAT(P3_VmStats, prefetched),
+    STAT(P3_VmStats, prefetchWasted), STAT(P3_VmStats, procSwapOuts),
+    STAT(P3_VmStats, procSwapPages), STAT(P3_VmStats, procSwapIns),
+    STAT(P3_VmStats, mappedPages), STAT(P3_VmStats, mapWrites),
+    STAT(P3_VmStats, softFaults), STAT(P3_VmStats, hardFaults), STAT(P3_VmStats, refaults),
+    STAT(P3_VmStats, wakePrefetched), STAT(P3_VmStats, procSwapFails),
+};
+
+static StatField procFields[] = {
+    STAT(P3_ProcStats, faults), STAT(P3_ProcStats, newPages), STAT(P3_ProcStats, pageIns),
+    STAT(P3_ProcStats, pageOuts), STAT(P3_ProcStats, replaced), STAT(P3_ProcStats, faultWait),
+};
+
+#define NUM_FIELDS(fields) ((int) (sizeof(fields) / sizeof(StatField)))
+
+// The options P3_VmOptionsParse knows, and the names it takes for values.
+typedef struct OptionField {
+    char    *name;
+    int     offset;
+    int     string;     // TRUE if the option is a char *, otherwise it is an int
+    int     max;        // largest value an int option takes, the smallest is 0
+} OptionField;
+
+#define OPTION(field, string, max) { #field, offsetof(P3_VmOptions, field), string, max }
+
+static OptionField optionFields[] = {
+    OPTION(pages, FALSE, INT_MAX), OPTION(frames, FALSE, INT_MAX),
+    OPTION(pagers, FALSE, P3_MAX_PAGERS), OPTION(swapUnits, FALSE, INT_MAX),
+    OPTION(swapSched, FALSE, P3_SCHED_CSCAN), OPTION(dedupInterval, FALSE, INT_MAX),
+    OPTION(compactInterval, FALSE, INT_MAX), OPTION(harvestInterval, FALSE, INT_MAX),
+    OPTION(zeroFrames, FALSE, TRUE),
+    OPTION(frameLimit, FALSE, INT_MAX), OPTION(prefetch, FALSE, INT_MAX),
+    OPTION(swapOutIdle, FALSE, INT_MAX), OPTION(inactivePercent, FALSE, 100),
+    OPTION(faultTrace, TRUE, 0),
+    OPTION(statsFile, TRUE, 0), OPTION(statsFormat, FALSE, P3_STATS_JSON),
+    OPTION(statsInterval, FALSE, INT_MAX),
+};
+
+static struct {
+    char    *name;
+    int     value;
+} optionValues[] = {
+    {"fifo", P3_SCHED_FIFO}, {"cscan", P3_SCHED_CSCAN}, {"csv", P3_STATS_CSV},
+    {"json", P3_STATS_JSON}, {"false", FALSE}, {"true", TRUE},
+};
+
+#define OPTION_SEPARATORS " \t,"
+#define NUM_OPTIONS ((int) (sizeof(optionFields) / sizeof(OptionField)))
+#define NUM_VALUES ((int) (sizeof(optionValues) / sizeof(optionValues[0])))
+
+#ifdef P3_TRACEPOINTS
+static P3_TpRecord  tpRing[P3_TP_RING];
+static unsigned     tpNext;     // # of records ever made, the next one goes in tpNext % P3_TP_RING
+
+/*
+ * Appends a tracepoint record to the ring, overwriting the oldest one. Interrupts are off
+ * so a process switch can't leave a record half-written.
+ */
+void
+P3Tracepoint(int event, int pid, int page, int frame, int unit, int arg)
+{
+    unsigned int    psr = USLOSS_PsrGet();
+    P3_TpRecord     *record;
+    int             rc;
+
+    rc = USLOSS_PsrSet(psr & ~USLOSS_PSR_CURRENT_INT);
+    assert(rc == USLOSS_ERR_OK);
+    record = &tpRing[tpNext++ % P3_TP_RING];
+    record->time = USLOSS_Clock();
+    record->event = event;
+    record->unit = unit;
+    record->pid = pid;
+    record->page = page;
+    record->frame = frame;
+    record->arg = arg;
+    rc = USLOSS_PsrSet(psr);
+    assert(rc == USLOSS_ERR_OK);
+}
+
+// writes the ring to P3_TP_FILE, oldest record first
+static void
+TpDump(void)
+{
+    FILE        *file;
+    unsigned    i = tpNext > P3_TP_RING ? tpNext - P3_TP_RING : 0;
+
+    file = fopen(P3_TP_FILE, "wb");
+    if (file == NULL) {
+        return;
+    }
+    for (; i < tpNext; i++) {
+        fwrite(&tpRing[i % P3_TP_RING], sizeof(P3_TpRecord), 1, file);
+    }
+    fclose(file);
+}
+
+static void
+TpAbort(int sig)
+{
+    TpDump();
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+#endif
 
 static void
 FaultHandler(int type, void *arg)
@@ -20,18 +234,253 @@ FaultHandler(int type, void *arg)
     /*******************
 
     if it's an access fault (USLOSS_MmuGetCause)
-        terminate faulting process w/ P3_ACCESS_VIOLATION
-    else
-        add fault information to a queue of pending faults
-        let the pager know that there is a pending fault
-        wait until the fault has been handled by the pager
-        terminate the process if necessary
+        queue it for the pager, it may be a write to a copy-on-write page
+    add fault information to a queue of pending faults
+    let the pager know that there is a pending fault
+    wait until the fault has been handled by the pager
+    terminate the process if necessary
 
     *********************/
+    int     offset = (int) arg;
+    PID     pid = P1_GetPid();
+    Fault   *fault = &faults[pid];
+    int     rc;
+    int     wait;
+
+    fault->pid = pid;
+    fault->page = offset / pageSize;
+    fault->cause = USLOSS_MmuGetCause();
+    fault->handled = FALSE;
+    fault->rc = P1_SUCCESS;
+    fault->start = USLOSS_Clock();
+    fault->prefetch = FALSE;
+    fault->next = NULL;
+    P3_TP(P3_TP_ENQUEUE, pid, fault->page, -1, -1, -1);
+
+    rc = P1_Lock(faultLock);
+    assert(rc == P1_SUCCESS);
+    if (faultTail == NULL) {
+        faultHead = fault;
+    } else {
+        faultTail->next = fault;
+    }
+    faultTail = fault;
+    P3_vmStats.faults++;
+    P3_procStats[pid].faults++;
+    rc = P1_Signal(faultPending);
+    assert(rc == P1_SUCCESS);
+    while (!fault->handled) {
+        rc = P1_Wait(faultDone);
+        assert(rc == P1_SUCCESS);
+    }
+    wait = USLOSS_Clock() - fault->start;
+    P3_vmStats.faultWait += wait;
+    P3_procStats[pid].faultWait += wait;
+    rc = P1_Unlock(faultLock);
+    assert(rc == P1_SUCCESS);
+    if (fault->rc != P1_SUCCESS) {
+        P2_Terminate(fault->rc);
+    }
+}
+
+// lets the faulting process continue
+static void
+FaultWake(Fault *fault)
+{
+    int rc;
+
+    P3_TP(P3_TP_WAKEUP, fault->pid, fault->page, fault->rc == P1_SUCCESS ?
+          pageTables[fault->pid][fault->page].frame : -1, -1, fault->rc);
+    rc = P1_Lock(faultLock);
+    assert(rc == P1_SUCCESS);
+    fault->handled = TRUE;
+    rc = P1_Broadcast(faultDone);
+    assert(rc == P1_SUCCESS);
+    rc = P1_Unlock(faultLock);
+    assert(rc == P1_SUCCESS);
+}
+
+// maps pid's page to frame
+static void
+PageMap(PID pid, int page, int frame)
+{
+    int rc;
+
+    pageTables[pid][page].incore = 1;
+    pageTables[pid][page].read = 1;
+    pageTables[pid][page].write = 1;
+    pageTables[pid][page].frame = frame;
+    if (pinnedPages[pid][page]) {
+        rc = P3FramePin(frame, 1);
+        assert(rc == P1_SUCCESS);
+    }
+}
+
+// maps the faulting page to frame and lets the faulting process continue
+static void
+FaultFinish(Fault *fault, int frame)
+{
+    if (fault->rc == P1_SUCCESS) {
+        PageMap(fault->pid, fault->page, frame);
+    }
+    FaultWake(fault);
+}
+
+/*
+ * Brings pid's page in ahead of a fault on it (P3PagePrefetch), mapping it now if it's
+ * ready or when its read is done (P3PageFaultDone). Called with the VM lock held.
+ */
+static int
+PagePrefetch(PID pid, int page)
+{
+    int frame;
+    int rc;
+
+    rc = P3PagePrefetch(pid, page, &frame);
+    if (rc == P3_IO_PENDING) {
+        prefetching[pid][page] = TRUE;
+        prefetchReads[pid]++;
+    } else if (rc == P1_SUCCESS) {
+        PageMap(pid, page, frame);
+    }
+    P3_TP(P3_TP_PREFETCH, pid, page, frame, -1, rc);
+    return rc;
+}
+
+/*
+ * Brings in the stream's window of pages after page, a stride apart, ahead of the faults on
+ * them, skipping the ones that are in memory or on their way already. Stops at the end of
+ * the VM region, or when there is no frame to spare. Called with the VM lock held.
+ */
+static void
+Prefetch(PID pid, int page)
+{
+    Stream      *stream = &streams[pid];
+    USLOSS_PTE  *table = pageTables[pid];
+    int         next = page;
+    int         rc;
+    int         i;
+
+    for (i = 0; i < stream->window; i++) {
+        next += stream->stride;
+        if ((next < 0) || (next >= numPages)) {
+            break;
+        }
+        if (table[next].incore || prefetching[pid][next]) {
+            continue;
+        }
+        rc = PagePrefetch(pid, next);
+        if ((rc != P1_SUCCESS) && (rc != P3_IO_PENDING)) {
+            break;
+        }
+        P3_vmStats.prefetched++;
+    }
+    // the stream has used all of these once it faults on the page after them
+    stream->end = (i == stream->window) ? next + stream->stride : next;
+}
+
+/*
+ * Brings back the pages that were swapped out with pid, or that it had in memory when it
+ * was seen blocked and has lost since (Swapper), all in one batch so the reads of adjacent
+ * blocks are merged. Called when pid wakes up, on its first fault or when the swapper sees
+ * it running, with the VM lock held.
+ */
+static void
+SetRestore(PID pid)
+{
+    USLOSS_PTE  *table = pageTables[pid];
+    int         rc;
+
+    for (int page = 0; page < numPages; page++) {
+        if (!swappedSet[pid][page] || table[page].incore || prefetching[pid][page]) {
+            continue;
+        }
+        rc = PagePrefetch(pid, page);
+        if ((rc != P1_SUCCESS) && (rc != P3_IO_PENDING)) {
+            break;
+        }
+        if (swappedOut[pid]) {
+            P3_vmStats.procSwapIns++;
+        } else {
+            P3_vmStats.wakePrefetched++;
+        }
+    }
+    memset(swappedSet[pid], 0, numPages);
+    swappedOut[pid] = FALSE;
+    asleep[pid] = FALSE;
+}
+
+/*
+ * Follows pid's faults for the prefetcher; page is the page of the fault being handled, and
+ * inflight is TRUE if the page is being prefetched already. On a confirmed stream a fault
+ * on the page after the prefetched ones means they were all used, and the window grows; a
+ * fault on one of them that isn't on its way means it was replaced before it was used, and
+ * the window shrinks. Any other fault starts a new stream. The pages after the fault are
+ * prefetched while the stream is confirmed. Called with the VM lock held.
+ */
+static void
+StreamFault(PID pid, int page, int inflight)
+{
+    Stream  *stream = &streams[pid];
+    int     stride = page - stream->last;
+    int     ahead, span;
 
+    if (stream->runs >= P3_PREFETCH_CONFIRM) {
+        // how many strides on from the previous fault the page and the stream's end are
+        ahead = (stride % stream->stride == 0) ? stride / stream->stride : -1;
+        span = (stream->end - stream->last) / stream->stride;
+        if (ahead == span) {
+            stream->window = stream->window * 2 < prefetchMax ? stream->window * 2 : prefetchMax;
+        } else if ((ahead > 0) && (ahead < span)) {
+            if (!inflight) {
+                P3_vmStats.prefetchWasted++;
+                stream->window = stream->window / 2 > 1 ? stream->window / 2 : 1;
+            }
+        } else {
+            stream->runs = 0;
+        }
+    }
+    if (stream->runs < P3_PREFETCH_CONFIRM) {
+        if ((stream->last != -1) && (stride != 0) && (stride == stream->stride)) {
+            stream->runs++;
+        } else {
+            stream->stride = stride;
+            stream->runs = (stream->last != -1) && (stride != 0);
+        }
+        stream->window = P3_PREFETCH_MIN < prefetchMax ? P3_PREFETCH_MIN : prefetchMax;
+    }
+    stream->last = page;
+    if ((stream->runs >= P3_PREFETCH_CONFIRM) && (stream->window > 0)) {
+        Prefetch(pid, page);
+    }
 }
 
-static int 
+/*
+ * Appends a record of the fault to the trace file, then takes read access away from the
+ * process's previous faulting page so the next reference to it is traced too.
+ */
+static void
+TraceRecord(Fault *fault, int kind, int frame, int block)
+{
+    P3_TraceRecord  record;
+    USLOSS_PTE      *table = pageTables[fault->pid];
+    int             last = traceLast[fault->pid];
+
+    record.time = USLOSS_Clock();
+    record.pid = fault->pid;
+    record.kind = kind;
+    record.unused = 0;
+    record.page = fault->page;
+    record.frame = frame;
+    record.block = block;
+    fwrite(&record, sizeof(record), 1, traceFile);
+    if ((last != -1) && (last != fault->page) && table[last].incore) {
+        table[last].read = 0;
+    }
+    traceLast[fault->pid] = fault->page;
+}
+
+static int
 Pager(void *arg)
 {
     /*******************
@@ -40,8 +489,17 @@ Pager(void *arg)
         wait for a fault
         if the process does not have a page table
             call USLOSS_Abort with an error message
-        rc = P3PageFaultResolve(pid, page, &frame)
-        if rc == P3_OUT_OF_SWAP
+        if tracing and the page was only made unreadable for the trace
+            make it readable, record the reference and unblock the process
+        if the fault is an access fault
+            rc = P3CowFaultResolve(pid, page, &frame)
+        else
+            rc = P3PageFaultResolve(pid, page, &frame)
+        if rc == P3_IO_PENDING
+            go on to the next fault, the swap disk finishes this one (P3PageFaultDone)
+        if rc == P3_FRAMES_BUSY
+            put the fault aside until a frame is idle (P3FrameIdle)
+        if rc == P3_OUT_OF_SWAP or rc == P3_ACCESS_VIOLATION
             mark the faulting process for termination
         else
             if rc == P3_NOT_IMPLEMENTED
@@ -50,26 +508,854 @@ Pager(void *arg)
        unblock faulting process
 
     *********************/
+    Fault       *fault;
+    USLOSS_PTE  *table;
+    int         frame;
+    int         old;
+    int         block;
+    int         rc;
+    int         result;
+    int         follow;
+    PID         pid;
+    int         page;
+
+    while (1) {
+        rc = P1_Lock(faultLock);
+        assert(rc == P1_SUCCESS);
+        while ((faultHead == NULL) && !vmShutdown) {
+            rc = P1_Wait(faultPending);
+            assert(rc == P1_SUCCESS);
+        }
+        if (vmShutdown) {
+            rc = P1_Unlock(faultLock);
+            assert(rc == P1_SUCCESS);
+            break;
+        }
+        fault = faultHead;
+        faultHead = fault->next;
+        if (faultHead == NULL) {
+            faultTail = NULL;
+        }
+        rc = P1_Unlock(faultLock);
+        assert(rc == P1_SUCCESS);
+        P3_TP(P3_TP_DEQUEUE, fault->pid, fault->page, -1, -1, -1);
+
+        rc = P1_Lock(vmLock);
+        assert(rc == P1_SUCCESS);
+        rc = P3PageTableGet(fault->pid, &table);
+        if ((rc != P1_SUCCESS) || (table == NULL)) {
+            USLOSS_Console("Pager: process %d does not have a page table.\n", fault->pid);
+            USLOSS_Halt(1);
+        }
+        if ((traceFile != NULL) && (fault->cause == USLOSS_MMU_ACCESS)
+            && table[fault->page].incore && !table[fault->page].read) {
+            table[fault->page].read = 1;
+            TraceRecord(fault, P3_TRACE_REF, table[fault->page].frame, -1);
+            FaultWake(fault);
+            rc = P1_Unlock(vmLock);
+            assert(rc == P1_SUCCESS);
+            continue;
+        }
+        if ((fault->cause != USLOSS_MMU_ACCESS) && table[fault->page].incore) {
+            // a prefetch brought the page in while the fault was queued
+            FaultWake(fault);
+            rc = P1_Unlock(vmLock);
+            assert(rc == P1_SUCCESS);
+            continue;
+        }
+        if ((fault->cause != USLOSS_MMU_ACCESS) && prefetching[fault->pid][fault->page]) {
+            // the prefetch finishes the fault when the page is in (P3PageFaultDone)
+            fault->prefetch = TRUE;
+            StreamFault(fault->pid, fault->page, TRUE);
+            rc = P1_Unlock(vmLock);
+            assert(rc == P1_SUCCESS);
+            continue;
+        }
+        if (traceFile != NULL) {
+            // where the page was before the fault moves it
+            rc = P3SwapBlock(fault->pid, fault->page, &block);
+            assert(rc == P1_SUCCESS);
+        }
+        if (fault->cause == USLOSS_MMU_ACCESS) {
+            old = table[fault->page].incore ? table[fault->page].frame : -1;
+            rc = P3CowFaultResolve(fault->pid, fault->page, &frame);
+            // the page left its old frame, FaultFinish pins the new one
+            if ((old != -1) && pinnedPages[fault->pid][fault->page]
+                && ((rc == P1_SUCCESS) || (rc == P3_IO_PENDING))) {
+                result = P3FramePin(old, -1);
+                assert(result == P1_SUCCESS);
+            }
+        } else {
+            rc = P3PageFaultResolve(fault->pid, fault->page, &frame);
+        }
+        if ((traceFile != NULL) && (rc != P3_FRAMES_BUSY)) {
+            TraceRecord(fault, fault->cause == USLOSS_MMU_ACCESS ? P3_TRACE_WRITE : P3_TRACE_FAULT,
+                        ((rc == P3_OUT_OF_SWAP) || (rc == P3_ACCESS_VIOLATION)) ? -1 : frame, block);
+        }
+        // the process can fault again once it is woken up, so the stream needs these now
+        follow = (fault->cause != USLOSS_MMU_ACCESS)
+                 && ((rc == P1_SUCCESS) || (rc == P3_IO_PENDING));
+        pid = fault->pid;
+        page = fault->page;
+        if (rc == P3_FRAMES_BUSY) {
+            fault->next = NULL;
+            if (busyTail == NULL) {
+                busyHead = fault;
+            } else {
+                busyTail->next = fault;
+            }
+            busyTail = fault;
+        } else if (rc != P3_IO_PENDING) {
+            if ((rc == P3_OUT_OF_SWAP) || (rc == P3_ACCESS_VIOLATION)) {
+                fault->rc = rc;
+            } else if (rc == P3_NOT_IMPLEMENTED) {
+                frame = fault->page;
+            }
+            FaultFinish(fault, frame);
+        }
+        if (follow) {
+            // the faulting page's frame isn't replaced to make room for the pages after it
+            rc = P3FramePin(frame, 1);
+            assert(rc == P1_SUCCESS);
+            if (swappedOut[pid] || asleep[pid]) {
+                SetRestore(pid);
+            }
+            StreamFault(pid, page, FALSE);
+            rc = P3FramePin(frame, -1);
+            assert(rc == P1_SUCCESS);
+        }
+        rc = P1_Unlock(vmLock);
+        assert(rc == P1_SUCCESS);
+    }
+    return 0;
+}
+
+/*
+ * Takes and releases the lock that protects the frame and swap structures, for the swap
+ * disk process when it finishes a request.
+ */
+void
+P3VmLock(void)
+{
+    int rc;
+
+    rc = P1_Lock(vmLock);
+    assert(rc == P1_SUCCESS);
+}
+
+void
+P3VmUnlock(void)
+{
+    int rc;
+
+    rc = P1_Unlock(vmLock);
+    assert(rc == P1_SUCCESS);
+}
+
+/*
+ * Finishes pid's fault on page once the swap I/O that brings the page into frame is done,
+ * or maps the page if it was prefetched, finishing the fault waiting for it if there is
+ * one. Called with the VM lock held.
+ */
+void
+P3PageFaultDone(PID pid, int page, int frame)
+{
+    Fault   *fault = &faults[pid];
+    int     rc;
+
+    if (pageTables[pid] == NULL) {
+        return;
+    }
+    if (prefetching[pid][page]) {
+        prefetching[pid][page] = FALSE;
+        prefetchReads[pid]--;
+        PageMap(pid, page, frame);
+        rc = P1_Broadcast(prefetchDone);
+        assert(rc == P1_SUCCESS);
+        if (fault->prefetch && (fault->page == page)) {
+            fault->prefetch = FALSE;
+            FaultWake(fault);
+        }
+        return;
+    }
+    if (fault->handled || (fault->page != page)) {
+        return;
+    }
+    FaultFinish(fault, frame);
+}
+
+/*
+ * A frame has no I/O outstanding any more, so the faults that found every frame busy go
+ * back to the front of the fault queue. Called with the VM lock held.
+ */
+void
+P3FrameIdle(void)
+{
+    int rc;
+
+    // a free frame that was busy can be zeroed now
+    rc = P1_Signal(frameFreed);
+    assert(rc == P1_SUCCESS);
+    if (busyHead == NULL) {
+        return;
+    }
+    rc = P1_Lock(faultLock);
+    assert(rc == P1_SUCCESS);
+    busyTail->next = faultHead;
+    if (faultHead == NULL) {
+        faultTail = busyTail;
+    }
+    faultHead = busyHead;
+    busyHead = busyTail = NULL;
+    rc = P1_Broadcast(faultPending);
+    assert(rc == P1_SUCCESS);
+    rc = P1_Unlock(faultLock);
+    assert(rc == P1_SUCCESS);
+}
+
+/*
+ * A frame was returned to the free pool, so the zeroer has work to do. Called with the VM
+ * lock held.
+ */
+void
+P3FrameFreed(void)
+{
+    int rc;
+
+    rc = P1_Signal(frameFreed);
+    assert(rc == P1_SUCCESS);
+}
+
+/*
+ * Periodically looks for frames with identical contents and merges them (P3DedupScan).
+ * Runs at the lowest priority so it only uses time the other processes don't want.
+ */
+static int
+Deduper(void *arg)
+{
+    int rc;
+
+    while (!vmShutdown) {
+        rc = P2_Sleep(dedupInterval);
+        assert(rc == P1_SUCCESS);
+        rc = P1_Lock(vmLock);
+        assert(rc == P1_SUCCESS);
+        if (!vmShutdown) {
+            rc = P3DedupScan();
+            assert(rc == P1_SUCCESS);
+        }
+        rc = P1_Unlock(vmLock);
+        assert(rc == P1_SUCCESS);
+    }
     return 0;
 }
 
+/*
+ * Periodically collects the reference bits for the clock (P3AccessHarvest) so the next
+ * fault that needs a frame doesn't have to.
+ */
+static int
+Harvester(void *arg)
+{
+    int rc;
+
+    while (!vmShutdown) {
+        rc = P2_Sleep(harvestInterval);
+        assert(rc == P1_SUCCESS);
+        rc = P1_Lock(vmLock);
+        assert(rc == P1_SUCCESS);
+        if (!vmShutdown) {
+            rc = P3AccessHarvest();
+            assert(rc == P1_SUCCESS);
+        }
+        rc = P1_Unlock(vmLock);
+        assert(rc == P1_SUCCESS);
+    }
+    return 0;
+}
+
+/*
+ * Periodically compacts swap (P3SwapCompact), a block at a time so faults aren't held up,
+ * until it is compact or the swap disks get busy.
+ */
+static int
+Compactor(void *arg)
+{
+    int rc;
+    int moved;
+
+    while (!vmShutdown) {
+        rc = P2_Sleep(compactInterval);
+        assert(rc == P1_SUCCESS);
+        do {
+            rc = P1_Lock(vmLock);
+            assert(rc == P1_SUCCESS);
+            moved = FALSE;
+            if (!vmShutdown) {
+                rc = P3SwapCompact(&moved);
+                assert(rc == P1_SUCCESS);
+            }
+            rc = P1_Unlock(vmLock);
+            assert(rc == P1_SUCCESS);
+        } while (moved);
+    }
+    return 0;
+}
+
+/*
+ * Once a second, looks for processes that have been blocked without running for
+ * swapOutIdle seconds and, if memory is tight, swaps out all their pages at once
+ * (P3ProcessSwapOut) instead of leaving them for the clock. They come back in one batch on
+ * the process's next fault (SetRestore). A process waiting for a fault or a prefetch is
+ * left alone, it will need its pages as soon as that is done. If swap runs out partway the
+ * process isn't counted as swapped out, procSwapFails is, and it is tried again later.
+ *
+ * If prefetching is on, the pages a process has in memory are also recorded the first time
+ * it is seen blocked, e.g. in Sys_Sleep. Whichever of them the clock takes while it sleeps
+ * are brought back in one batch as soon as it wakes up: on its first fault, or when the
+ * swapper sees it has run if that comes first. Its first quantum after waking then doesn't
+ * fault on them one at a time.
+ */
+static int
+Swapper(void *arg)
+{
+    P1_ProcInfo info;
+    USLOSS_PTE  *table;
+    int         blocked;
+    int         count;
+    int         rc;
+
+    while (!vmShutdown) {
+        rc = P2_Sleep(1);
+        assert(rc == P1_SUCCESS);
+        rc = P1_Lock(vmLock);
+        assert(rc == P1_SUCCESS);
+        for (int pid = 0; (pid < P1_MAXPROC) && !vmShutdown; pid++) {
+            table = pageTables[pid];
+            if ((table == NULL) || swappedOut[pid]) {
+                continue;
+            }
+            rc = P1_GetProcInfo(pid, &info);
+            if (rc != P1_SUCCESS) {
+                // it quit and its page table hasn't been freed yet
+                continue;
+            }
+            blocked = faults[pid].handled && (prefetchReads[pid] == 0)
+                      && ((info.state == P1_STATE_BLOCKED) || (info.state == P1_STATE_JOINING));
+            if (asleep[pid] && (!blocked || (info.cpu != idleCpu[pid]))) {
+                // woke up since its pages were recorded
+                SetRestore(pid);
+            }
+            if (blocked && !asleep[pid] && (prefetchMax > 0)) {
+                for (int page = 0; page < numPages; page++) {
+                    swappedSet[pid][page] = table[page].incore;
+                }
+                asleep[pid] = TRUE;
+            }
+            if ((info.cpu != idleCpu[pid]) || !blocked) {
+                idleCpu[pid] = info.cpu;
+                idleTime[pid] = 0;
+                continue;
+            }
+            if ((swapOutIdle == 0) || (++idleTime[pid] < swapOutIdle)
+                || (P3_vmStats.freeFrames * 100 >= P3_vmStats.frames * P3_SWAPOUT_FREE_PERCENT)) {
+                continue;
+            }
+            // along with any it had when it was recorded asleep and has lost since
+            for (int page = 0; page < numPages; page++) {
+                swappedSet[pid][page] = swappedSet[pid][page] || table[page].incore;
+            }
+            rc = P3ProcessSwapOut(pid, &count);
+            assert((rc == P1_SUCCESS) || (rc == P3_OUT_OF_SWAP));
+            // only the pages that went are brought back
+            for (int page = 0; page < numPages; page++) {
+                swappedSet[pid][page] = swappedSet[pid][page] && !table[page].incore;
+            }
+            if (rc != P1_SUCCESS) {
+                // the pages that went fault back one at a time, or come back when it wakes
+                // if it was recorded asleep; it is tried again after another swapOutIdle
+                if (!asleep[pid]) {
+                    memset(swappedSet[pid], 0, numPages);
+                }
+                idleTime[pid] = 0;
+                P3_vmStats.procSwapFails++;
+                continue;
+            }
+            swappedOut[pid] = TRUE;
+            P3_vmStats.procSwapOuts++;
+            P3_vmStats.procSwapPages += count;
+        }
+        rc = P1_Unlock(vmLock);
+        assert(rc == P1_SUCCESS);
+    }
+    return 0;
+}
+
+// P3_StatsDump of the given statistics, taken at time
+static void
+StatsWrite(FILE *file, int format, int time, P3_VmStats *vm, P3_ProcStats *procs)
+{
+    char    *sep = "";
+    int     i;
+
+    if (format == P3_STATS_JSON) {
+        fprintf(file, "{\"time\": %d", time);
+        for (i = 0; i < NUM_FIELDS(vmFields); i++) {
+            fprintf(file, ", \"%s\": %d", vmFields[i].name, STAT_VALUE(vm, &vmFields[i]));
+        }
+        fprintf(file, ", \"procs\": [");
+        for (int pid = 0; pid < P1_MAXPROC; pid++) {
+            if (procs[pid].faults == 0) {
+                continue;
+            }
+            fprintf(file, "%s{\"pid\": %d", sep, pid);
+            for (i = 0; i < NUM_FIELDS(procFields); i++) {
+                fprintf(file, ", \"%s\": %d", procFields[i].name,
+                        STAT_VALUE(&procs[pid], &procFields[i]));
+            }
+            fprintf(file, "}");
+            sep = ", ";
+        }
+        fprintf(file, "]}\n");
+    } else {
+        if (ftell(file) == 0) {
+            fprintf(file, "time");
+            for (i = 0; i < NUM_FIELDS(vmFields); i++) {
+                fprintf(file, ",%s", vmFields[i].name);
+            }
+            fprintf(file, "\n");
+        }
+        fprintf(file, "%d", time);
+        for (i = 0; i < NUM_FIELDS(vmFields); i++) {
+            fprintf(file, ",%d", STAT_VALUE(vm, &vmFields[i]));
+        }
+        fprintf(file, "\n");
+    }
+    fflush(file);
+}
+
+/*
+ * Copies the statistics into the ring every P3_statsInterval clock interrupts, overwriting
+ * the oldest snapshot if StatsWriter hasn't got to it, then passes the interrupt on to the
+ * clock handler that was there before. No I/O is done here, StatsWriter does that.
+ */
+static void
+StatsClock(int type, void *arg)
+{
+    StatsSnapshot   *snapshot;
+
+    if (++statsTicks >= P3_statsInterval) {
+        statsTicks = 0;
+        snapshot = &statsRing[statsTaken % P3_STATS_RING];
+        snapshot->time = USLOSS_Clock();
+        snapshot->vm = P3_vmStats;
+        memcpy(snapshot->procs, P3_procStats, sizeof(snapshot->procs));
+        statsTaken++;
+    }
+    clockHandler(type, arg);
+}
+
+/*
+ * Writes the snapshots StatsClock has taken since the last call to statsFile, oldest first.
+ * Each one is copied out with interrupts off so StatsClock can't change it halfway. The
+ * caller holds vmLock, which keeps statsFile open.
+ */
+static void
+StatsDrain(void)
+{
+    unsigned int    psr = USLOSS_PsrGet();
+    StatsSnapshot   snapshot;
+    int             rc;
+
+    while (TRUE) {
+        rc = USLOSS_PsrSet(psr & ~USLOSS_PSR_CURRENT_INT);
+        assert(rc == USLOSS_ERR_OK);
+        if (statsTaken - statsWritten > P3_STATS_RING) {
+            // the oldest ones were overwritten
+            statsWritten = statsTaken - P3_STATS_RING;
+        }
+        if (statsWritten == statsTaken) {
+            rc = USLOSS_PsrSet(psr);
+            assert(rc == USLOSS_ERR_OK);
+            break;
+        }
+        snapshot = statsRing[statsWritten++ % P3_STATS_RING];
+        rc = USLOSS_PsrSet(psr);
+        assert(rc == USLOSS_ERR_OK);
+        StatsWrite(statsFile, P3_statsFormat, snapshot.time, &snapshot.vm, snapshot.procs);
+    }
+}
+
+/*
+ * Once a second, writes the snapshots StatsClock has taken (StatsDrain), so the file I/O is
+ * done in a process instead of the interrupt handler.
+ */
+static int
+StatsWriter(void *arg)
+{
+    int rc;
+
+    while (!vmShutdown) {
+        rc = P2_Sleep(1);
+        assert(rc == P1_SUCCESS);
+        rc = P1_Lock(vmLock);
+        assert(rc == P1_SUCCESS);
+        if (statsFile != NULL) {
+            StatsDrain();
+        }
+        rc = P1_Unlock(vmLock);
+        assert(rc == P1_SUCCESS);
+    }
+    return 0;
+}
+
+/*
+ * Zeroes free frames a frame at a time (P3FrameZeroFree) so new pages don't have to wait
+ * for it, and waits for a frame to be freed when there are none left to do. Runs at the
+ * lowest priority so it only uses time the other processes don't want.
+ */
+static int
+Zeroer(void *arg)
+{
+    int rc;
+    int zeroed;
+
+    rc = P1_Lock(vmLock);
+    assert(rc == P1_SUCCESS);
+    while (!vmShutdown) {
+        rc = P3FrameZeroFree(&zeroed);
+        assert(rc == P1_SUCCESS);
+        if (zeroed) {
+            // let the others have the lock between frames
+            rc = P1_Unlock(vmLock);
+            assert(rc == P1_SUCCESS);
+            rc = P1_Lock(vmLock);
+            assert(rc == P1_SUCCESS);
+        } else {
+            rc = P1_Wait(frameFreed);
+            assert(rc == P1_SUCCESS);
+        }
+    }
+    rc = P1_Unlock(vmLock);
+    assert(rc == P1_SUCCESS);
+    return 0;
+}
+
+/*
+ * Sets the options to their defaults, see P3_VmOptions. Every background process is off.
+ */
+void
+P3_VmOptionsInit(P3_VmOptions *options)
+{
+    char    *list;
+    int     rc;
+
+    memset(options, 0, sizeof(*options));
+    options->version = P3_VM_OPTIONS_VERSION;
+    options->pagers = P3_MAX_PAGERS;
+    options->swapUnits = P3_swapUnits;
+    options->swapSched = P3_swapSched;
+    options->inactivePercent = P3_inactivePercent;
+    options->faultTrace = P3_faultTrace;
+    options->statsFile = P3_statsFile;
+    options->statsFormat = P3_statsFormat;
+    options->statsInterval = P3_statsInterval;
+    list = getenv("P3_VM_OPTIONS");
+    if (list != NULL) {
+        rc = P3_VmOptionsParse(options, list);
+        if (rc != P1_SUCCESS) {
+            USLOSS_Console("P3_VmOptionsInit: invalid P3_VM_OPTIONS \"%s\".\n", list);
+        }
+    }
+}
+
+/*
+ * Changes the options named in list, a list of name=value separated by spaces or commas.
+ * Returns P3_INVALID_OPTIONS if a name is not known or a value is not valid for it, and
+ * then none of the options have been changed. The strings the options point to are kept
+ * in a copy of list.
+ */
+int
+P3_VmOptionsParse(P3_VmOptions *options, char *list)
+{
+    P3_VmOptions    parsed = *options;
+    char    *copy;
+    char    *save, *token, *value, *end;
+    void    *field;
+    long    number;
+    int     i, j;
+    int     rc = P1_SUCCESS;
+    int     strings = FALSE;
+
+    copy = strdup(list);
+    if (copy == NULL) {
+        return P3_INVALID_OPTIONS;
+    }
+    for (token = strtok_r(copy, OPTION_SEPARATORS, &save); token != NULL;
+         token = strtok_r(NULL, OPTION_SEPARATORS, &save)) {
+        rc = P3_INVALID_OPTIONS;
+        value = strchr(token, '=');
+        if (value == NULL) {
+            break;
+        }
+        *value++ = '\0';
+        for (i = 0; (i < NUM_OPTIONS) && (strcmp(token, optionFields[i].name) != 0); i++) {
+        }
+        if (i == NUM_OPTIONS) {
+            break;
+        }
+        field = (char *) &parsed + optionFields[i].offset;
+        if (optionFields[i].string) {
+            *(char **) field = value;
+            strings = TRUE;
+            rc = P1_SUCCESS;
+            continue;
+        }
+        for (j = 0; (j < NUM_VALUES) && (strcmp(value, optionValues[j].name) != 0); j++) {
+        }
+        if (j < NUM_VALUES) {
+            number = optionValues[j].value;
+        } else {
+            errno = 0;
+            number = strtol(value, &end, 0);
+            if ((*value == '\0') || (*end != '\0') || (errno != 0)) {
+                break;
+            }
+        }
+        if ((number < 0) || (number > optionFields[i].max)) {
+            break;
+        }
+        *(int *) field = (int) number;
+        rc = P1_SUCCESS;
+    }
+    if (rc == P1_SUCCESS) {
+        *options = parsed;
+    }
+    // The copy is kept only if a string option points into it.
+    if ((rc != P1_SUCCESS) || !strings) {
+        free(copy);
+    }
+    return rc;
+}
+
+/*
+ * The original interface, with the default options (P3_VmOptionsInit) for everything but
+ * the size of the VM region and physical memory, and the number of pagers.
+ */
 int
 P3_VmInit(int unused, int pages, int frames, int pagers)
 {
+    P3_VmOptions    options;
+
+    P3_VmOptionsInit(&options);
+    options.pages = pages;
+    options.frames = frames;
+    options.pagers = pagers;
+    return P3_VmInitEx(&options);
+}
+
+int
+P3_VmInitEx(P3_VmOptions *options)
+{
+    int     rc;
+    int     pid;
+    int     pages, frames;
+    char    name[P1_MAXNAME];
+
+    if (vmInitialized) {
+        return P3_ALREADY_INITIALIZED;
+    }
+    if ((options == NULL) || (options->version != P3_VM_OPTIONS_VERSION)
+        || ((options->swapSched != P3_SCHED_FIFO) && (options->swapSched != P3_SCHED_CSCAN))
+        || ((options->statsFormat != P3_STATS_CSV) && (options->statsFormat != P3_STATS_JSON))
+        || (options->dedupInterval < 0) || (options->compactInterval < 0)
+        || (options->harvestInterval < 0)
+        || (options->statsInterval < 0) || (options->frameLimit < 0)
+        || (options->prefetch < 0) || (options->swapOutIdle < 0)
+        || (options->inactivePercent < 0) || (options->inactivePercent > 100)) {
+        return P3_INVALID_OPTIONS;
+    }
+    pages = options->pages;
+    frames = options->frames;
+    if (pages <= 0) {
+        return P3_INVALID_NUM_PAGES;
+    }
+    if (frames <= 0) {
+        return P3_INVALID_NUM_FRAMES;
+    }
+    if ((options->pagers <= 0) || (options->pagers > P3_MAX_PAGERS)) {
+        return P3_INVALID_NUM_PAGERS;
+    }
+    if ((options->swapUnits == 0)
+        || ((options->swapUnits & ~((1 << USLOSS_DISK_UNITS) - 1)) != 0)) {
+        return P3_INVALID_SWAP_UNITS;
+    }
+    // the frame and swap code and the snapshots read these
+    P3_swapUnits = options->swapUnits;
+    P3_swapSched = options->swapSched;
+    P3_inactivePercent = options->inactivePercent;
+    P3_faultTrace = options->faultTrace;
+    P3_statsFile = options->statsFile;
+    P3_statsFormat = options->statsFormat;
+    P3_statsInterval = options->statsInterval;
+    dedupInterval = options->dedupInterval;
+    compactInterval = options->compactInterval;
+    harvestInterval = options->harvestInterval;
+    frameLimit = options->frameLimit;
+    swapOutIdle = options->swapOutIdle;
+
+    rc = USLOSS_MmuInit(pages, pages, frames, USLOSS_MMU_MODE_PAGETABLE);
+    assert(rc == USLOSS_MMU_OK);
+    numPages = pages;
+    pageSize = USLOSS_MmuPageSize();
+    vmRegion = USLOSS_MmuRegion(&rc);
+    numPinned = 0;
+    maxPinned = frames * P3_MAX_PINNED_PERCENT / 100;
+    // a window much bigger than this would replace the pages the stream is still using
+    prefetchMax = options->prefetch < frames / 4 ? options->prefetch : frames / 4;
+
     // zero P3_vmStats
+    memset(&P3_vmStats, 0, sizeof(P3_vmStats));
+    P3_vmStats.pages = pages;
+    P3_vmStats.frames = frames;
+
     // initialize fault queue, lock, and condition variable
-    // call P3FrameInit
-    // call P3SwapInit
-    // fork pager
+    faultHead = faultTail = NULL;
+    busyHead = busyTail = NULL;
+    rc = P1_LockCreate("P3FaultLock", &faultLock);
+    assert(rc == P1_SUCCESS);
+    rc = P1_CondCreate("P3FaultPending", faultLock, &faultPending);
+    assert(rc == P1_SUCCESS);
+    rc = P1_CondCreate("P3FaultDone", faultLock, &faultDone);
+    assert(rc == P1_SUCCESS);
+    rc = P1_LockCreate("P3VmLock", &vmLock);
+    assert(rc == P1_SUCCESS);
+    rc = P1_CondCreate("P3FrameFreed", vmLock, &frameFreed);
+    assert(rc == P1_SUCCESS);
+    rc = P1_CondCreate("P3PrefetchDone", vmLock, &prefetchDone);
+    assert(rc == P1_SUCCESS);
 
+    if (P3_faultTrace != NULL) {
+        traceFile = fopen(P3_faultTrace, "wb");
+        if (traceFile == NULL) {
+            USLOSS_Console("P3_VmInit: can't open fault trace %s.\n", P3_faultTrace);
+        }
+        for (int i = 0; i < P1_MAXPROC; i++) {
+            traceLast[i] = -1;
+        }
+    }
+    memset(P3_procStats, 0, sizeof(P3_procStats));
+#ifdef P3_TRACEPOINTS
+    atexit(TpDump);
+    signal(SIGABRT, TpAbort);
+#endif
+    if (P3_statsFile != NULL) {
+        statsFile = fopen(P3_statsFile, "w");
+        if (statsFile == NULL) {
+            USLOSS_Console("P3_VmInit: can't open statistics file %s.\n", P3_statsFile);
+        }
+    }
+
+    rc = P3FrameInit(pages, frames);
+    assert(rc == P1_SUCCESS);
+    rc = P3SwapInit(pages, frames);
+    assert(rc == P1_SUCCESS);
+
+    vmShutdown = FALSE;
+    vmInitialized = TRUE;
     USLOSS_IntVec[USLOSS_MMU_INT] = FaultHandler;
+    if ((statsFile != NULL) && (P3_statsInterval > 0)) {
+        statsTicks = 0;
+        statsTaken = 0;
+        statsWritten = 0;
+        clockHandler = USLOSS_IntVec[USLOSS_CLOCK_INT];
+        USLOSS_IntVec[USLOSS_CLOCK_INT] = StatsClock;
+        rc = P1_Fork("StatsWriter", StatsWriter, NULL, USLOSS_MIN_STACK * 4, P3_STATS_PRIORITY,
+                     0, &pid);
+        assert(rc == P1_SUCCESS);
+    }
+
+    // fork pagers
+    for (int i = 0; i < options->pagers; i++) {
+        snprintf(name, sizeof(name), "Pager%d", i);
+        rc = P1_Fork(name, Pager, NULL, USLOSS_MIN_STACK * 4, P3_PAGER_PRIORITY, 0, &pid);
+        assert(rc == P1_SUCCESS);
+    }
+    if (dedupInterval > 0) {
+        rc = P1_Fork("Deduper", Deduper, NULL, USLOSS_MIN_STACK * 4, P3_DEDUP_PRIORITY, 0, &pid);
+        assert(rc == P1_SUCCESS);
+    }
+    if (compactInterval > 0) {
+        rc = P1_Fork("Compactor", Compactor, NULL, USLOSS_MIN_STACK * 4, P3_COMPACT_PRIORITY, 0,
+                     &pid);
+        assert(rc == P1_SUCCESS);
+    }
+    if (harvestInterval > 0) {
+        rc = P1_Fork("Harvester", Harvester, NULL, USLOSS_MIN_STACK * 4, P3_HARVEST_PRIORITY, 0,
+                     &pid);
+        assert(rc == P1_SUCCESS);
+    }
+    if ((swapOutIdle > 0) || (prefetchMax > 0)) {
+        rc = P1_Fork("Swapper", Swapper, NULL, USLOSS_MIN_STACK * 4, P3_SWAPOUT_PRIORITY, 0,
+                     &pid);
+        assert(rc == P1_SUCCESS);
+    }
+    if (options->zeroFrames) {
+        rc = P1_Fork("Zeroer", Zeroer, NULL, USLOSS_MIN_STACK * 4, P3_ZERO_PRIORITY, 0, &pid);
+        assert(rc == P1_SUCCESS);
+    }
     return P1_SUCCESS;
 }
 
 void
 P3_VmShutdown(void)
 {
+    int rc;
+
+    if (!vmInitialized) {
+        return;
+    }
     // cause pager to quit
+    rc = P1_Lock(faultLock);
+    assert(rc == P1_SUCCESS);
+    vmShutdown = TRUE;
+    rc = P1_Broadcast(faultPending);
+    assert(rc == P1_SUCCESS);
+    rc = P1_Unlock(faultLock);
+    assert(rc == P1_SUCCESS);
+    // and the zeroer
+    rc = P1_Lock(vmLock);
+    assert(rc == P1_SUCCESS);
+    rc = P1_Broadcast(frameFreed);
+    assert(rc == P1_SUCCESS);
+    rc = P1_Unlock(vmLock);
+    assert(rc == P1_SUCCESS);
+    P3SwapShutdown();
+    if (traceFile != NULL) {
+        rc = P1_Lock(vmLock);
+        assert(rc == P1_SUCCESS);
+        fclose(traceFile);
+        traceFile = NULL;
+        rc = P1_Unlock(vmLock);
+        assert(rc == P1_SUCCESS);
+    }
+    if (statsFile != NULL) {
+        // stop the snapshots and write the ones left before the last one
+        if (USLOSS_IntVec[USLOSS_CLOCK_INT] == StatsClock) {
+            USLOSS_IntVec[USLOSS_CLOCK_INT] = clockHandler;
+        }
+        rc = P1_Lock(vmLock);
+        assert(rc == P1_SUCCESS);
+        StatsDrain();
+        P3_StatsDump(statsFile, P3_statsFormat);
+        fclose(statsFile);
+        statsFile = NULL;
+        rc = P1_Unlock(vmLock);
+        assert(rc == P1_SUCCESS);
+    }
+#ifdef P3_TRACEPOINTS
+    TpDump();
+#endif
     P3_PrintStats(&P3_vmStats);
 }
 
@@ -77,20 +1363,294 @@ USLOSS_PTE *
 P3_AllocatePageTable(int pid)
 {
     USLOSS_PTE  *table = NULL;
-    // create a new page table here
+    int         rc;
+
+    if ((pid < 0) || (pid >= P1_MAXPROC)) {
+        USLOSS_Console("P3_AllocatePageTable: invalid pid %d.\n", pid);
+        USLOSS_Halt(1);
+    }
+    if (pageTables[pid] != NULL) {
+        USLOSS_Console("P3_AllocatePageTable: process %d already has a page table.\n", pid);
+        USLOSS_Halt(1);
+    }
+    // create a new page table here, all pages start out not in memory
+    if (vmInitialized) {
+        table = (USLOSS_PTE *) calloc(numPages, sizeof(USLOSS_PTE));
+        pageTables[pid] = table;
+        pinnedPages[pid] = (char *) calloc(numPages, sizeof(char));
+        prefetching[pid] = (char *) calloc(numPages, sizeof(char));
+        prefetchReads[pid] = 0;
+        memset(&streams[pid], 0, sizeof(streams[pid]));
+        streams[pid].last = -1;
+        swappedSet[pid] = (char *) calloc(numPages, sizeof(char));
+        swappedOut[pid] = FALSE;
+        asleep[pid] = FALSE;
+        idleTime[pid] = 0;
+        // no fault outstanding, for the swapper
+        faults[pid].handled = TRUE;
+        traceLast[pid] = -1;
+        memset(&P3_procStats[pid], 0, sizeof(P3_procStats[pid]));
+        rc = P1_Lock(vmLock);
+        assert(rc == P1_SUCCESS);
+        rc = P3FrameLimitSet(pid, frameLimit);
+        assert(rc == P1_SUCCESS);
+        rc = P1_Unlock(vmLock);
+        assert(rc == P1_SUCCESS);
+    }
     return table;
 }
 
+// unpins pid's pinned pages among count starting at page, called with the VM lock held
+static int
+PagesUnpin(int pid, int page, int count)
+{
+    USLOSS_PTE  *table = pageTables[pid];
+    int         rc;
+
+    for (int i = page; i < page + count; i++) {
+        if (pinnedPages[pid][i]) {
+            pinnedPages[pid][i] = FALSE;
+            numPinned--;
+            if (table[i].incore) {
+                rc = P3FramePin(table[i].frame, -1);
+                assert(rc == P1_SUCCESS);
+            }
+        }
+    }
+    return P1_SUCCESS;
+}
+
 void
 P3_FreePageTable(int pid)
 {
-    // free the page table here
+    int rc;
+
+    if ((pid < 0) || (pid >= P1_MAXPROC)) {
+        USLOSS_Console("P3_FreePageTable: invalid pid %d.\n", pid);
+        USLOSS_Halt(1);
+    }
+    if (pageTables[pid] == NULL) {
+        return;
+    }
+    // free the page table here, along with its frames and swap space
+    rc = P1_Lock(vmLock);
+    assert(rc == P1_SUCCESS);
+    // the frames being prefetched into can't be freed until their reads are done
+    while (prefetchReads[pid] > 0) {
+        rc = P1_Wait(prefetchDone);
+        assert(rc == P1_SUCCESS);
+    }
+    free(prefetching[pid]);
+    prefetching[pid] = NULL;
+    free(swappedSet[pid]);
+    swappedSet[pid] = NULL;
+    rc = PagesUnpin(pid, 0, numPages);
+    assert(rc == P1_SUCCESS);
+    free(pinnedPages[pid]);
+    pinnedPages[pid] = NULL;
+    // changes to mapped pages go back to their disk before the frames are freed
+    rc = P3MapSync(pid);
+    assert(rc == P1_SUCCESS);
+    rc = P3FrameFreeAll(pid);
+    assert(rc == P1_SUCCESS);
+    rc = P3SwapFreeAll(pid);
+    assert(rc == P1_SUCCESS);
+    free(pageTables[pid]);
+    pageTables[pid] = NULL;
+    rc = P1_Unlock(vmLock);
+    assert(rc == P1_SUCCESS);
+}
+
+/*
+ * Makes count of pid's pages starting at page into a shared region that other processes can
+ * map with P3_VmAttach. The region's handle is returned in *handle.
+ */
+int
+P3_VmShare(int pid, int page, int count, int *handle)
+{
+    int rc;
+    int result;
+
+    if (!vmInitialized) {
+        return P3_NOT_INITIALIZED;
+    }
+    if ((pid < 0) || (pid >= P1_MAXPROC) || (pageTables[pid] == NULL)) {
+        return P1_INVALID_PID;
+    }
+    if ((page < 0) || (count <= 0) || (page + count > numPages)) {
+        return P3_INVALID_PAGE;
+    }
+    rc = P1_Lock(vmLock);
+    assert(rc == P1_SUCCESS);
+    result = P3ShareCreate(pid, page, count, handle);
+    rc = P1_Unlock(vmLock);
+    assert(rc == P1_SUCCESS);
+    return result;
+}
+
+/*
+ * Maps the shared region into pid's pages starting at page. Writes by any process attached
+ * to the region are seen by all of them.
+ */
+int
+P3_VmAttach(int handle, int pid, int page)
+{
+    int rc;
+    int result;
+
+    if (!vmInitialized) {
+        return P3_NOT_INITIALIZED;
+    }
+    if ((pid < 0) || (pid >= P1_MAXPROC) || (pageTables[pid] == NULL)) {
+        return P1_INVALID_PID;
+    }
+    rc = P1_Lock(vmLock);
+    assert(rc == P1_SUCCESS);
+    result = P3ShareAttach(handle, pid, page);
+    rc = P1_Unlock(vmLock);
+    assert(rc == P1_SUCCESS);
+    return result;
+}
+
+/*
+ * Maps count of pid's pages starting at page to disk unit's page sized blocks starting at
+ * block, so that the pages are read from the disk when they are first touched and changes
+ * to them are written back to it rather than to swap (P3MapCreate). The pages must not
+ * have been used yet.
+ */
+int
+P3_VmMap(int pid, int page, int count, int unit, int block)
+{
+    int rc;
+    int result;
+
+    if (!vmInitialized) {
+        return P3_NOT_INITIALIZED;
+    }
+    if ((pid < 0) || (pid >= P1_MAXPROC) || (pageTables[pid] == NULL)) {
+        return P1_INVALID_PID;
+    }
+    rc = P1_Lock(vmLock);
+    assert(rc == P1_SUCCESS);
+    result = P3MapCreate(pid, page, count, unit, block);
+    rc = P1_Unlock(vmLock);
+    assert(rc == P1_SUCCESS);
+    return result;
+}
+
+/*
+ * Pins count of pid's pages starting at page, so they stay in memory until they are
+ * unpinned (P3_VmUnlock) or pid quits. Pages in memory are pinned to their frames now,
+ * others when they are faulted in; if pid is the caller they are faulted in before this
+ * returns. No more than P3_MAX_PINNED_PERCENT of the frames' worth of pages can be pinned
+ * at once.
+ */
+int
+P3_VmLock(int pid, int page, int count)
+{
+    USLOSS_PTE  *table;
+    int         rc;
+    int         result = P1_SUCCESS;
+    int         more = 0;
+
+    if (!vmInitialized) {
+        return P3_NOT_INITIALIZED;
+    }
+    if ((pid < 0) || (pid >= P1_MAXPROC) || (pageTables[pid] == NULL)) {
+        return P1_INVALID_PID;
+    }
+    if ((page < 0) || (count <= 0) || (page + count > numPages)) {
+        return P3_INVALID_PAGE;
+    }
+    table = pageTables[pid];
+    rc = P1_Lock(vmLock);
+    assert(rc == P1_SUCCESS);
+    for (int i = page; i < page + count; i++) {
+        more += !pinnedPages[pid][i];
+    }
+    if (numPinned + more > maxPinned) {
+        result = P3_TOO_MANY_PINNED;
+    } else {
+        for (int i = page; i < page + count; i++) {
+            if (!pinnedPages[pid][i]) {
+                pinnedPages[pid][i] = TRUE;
+                numPinned++;
+                if (table[i].incore) {
+                    rc = P3FramePin(table[i].frame, 1);
+                    assert(rc == P1_SUCCESS);
+                }
+            }
+        }
+    }
+    rc = P1_Unlock(vmLock);
+    assert(rc == P1_SUCCESS);
+    if ((result == P1_SUCCESS) && (pid == P1_GetPid())) {
+        // touching the pages faults in the ones that aren't in memory
+        for (int i = page; i < page + count; i++) {
+            (void) *(volatile char *) (vmRegion + i * pageSize);
+        }
+    }
+    return result;
+}
+
+/*
+ * Unpins count of pid's pages starting at page, the ones that aren't pinned are left alone.
+ */
+int
+P3_VmUnlock(int pid, int page, int count)
+{
+    int rc;
+
+    if (!vmInitialized) {
+        return P3_NOT_INITIALIZED;
+    }
+    if ((pid < 0) || (pid >= P1_MAXPROC) || (pageTables[pid] == NULL)) {
+        return P1_INVALID_PID;
+    }
+    if ((page < 0) || (count <= 0) || (page + count > numPages)) {
+        return P3_INVALID_PAGE;
+    }
+    rc = P1_Lock(vmLock);
+    assert(rc == P1_SUCCESS);
+    rc = PagesUnpin(pid, page, count);
+    assert(rc == P1_SUCCESS);
+    rc = P1_Unlock(vmLock);
+    assert(rc == P1_SUCCESS);
+    return P1_SUCCESS;
+}
+
+/*
+ * Limits pid to limit frames, 0 for no limit. Once pid has limit frames its faults replace
+ * its own pages instead of other processes', unless they are all pinned (P3_VmLock), in
+ * which case it goes over the limit. Processes start with the frameLimit option.
+ */
+int
+P3_SetFrameLimit(int pid, int limit)
+{
+    int rc;
+    int result;
+
+    if (!vmInitialized) {
+        return P3_NOT_INITIALIZED;
+    }
+    if ((pid < 0) || (pid >= P1_MAXPROC) || (pageTables[pid] == NULL)) {
+        return P1_INVALID_PID;
+    }
+    rc = P1_Lock(vmLock);
+    assert(rc == P1_SUCCESS);
+    result = P3FrameLimitSet(pid, limit);
+    rc = P1_Unlock(vmLock);
+    assert(rc == P1_SUCCESS);
+    return result;
 }
 
 int
 P3PageTableGet(PID pid, USLOSS_PTE **table)
 {
-    *table = NULL;
+    if ((pid < 0) || (pid >= P1_MAXPROC)) {
+        return P1_INVALID_PID;
+    }
+    *table = pageTables[pid];
     return P1_SUCCESS;
 }
 
@@ -125,5 +1685,46 @@ P3_PrintStats(P3_VmStats *stats)
     USLOSS_Console("\tpageIns:\t%d\n", stats->pageIns);
     USLOSS_Console("\tpageOuts:\t%d\n", stats->pageOuts);
     USLOSS_Console("\treplaced:\t%d\n", stats->replaced);
+    USLOSS_Console("\tfillPages:\t%d\n", stats->fillPages);
+    USLOSS_Console("\tmerged:\t\t%d\n", stats->merged);
+    USLOSS_Console("\tcowFaults:\t%d\n", stats->cowFaults);
+    USLOSS_Console("\tioRequests:\t%d\n", stats->ioRequests);
+    USLOSS_Console("\tioTransfers:\t%d\n", stats->ioTransfers);
+    USLOSS_Console("\tioSeek:\t\t%d\n", stats->ioSeek);
+    if (stats->ioRequests > 0) {
+        USLOSS_Console("\tioLatency:\t%d\n", stats->ioWait / stats->ioRequests);
+    }
+    USLOSS_Console("\tcompacted:\t%d\n", stats->compacted);
+    USLOSS_Console("\tfragmentation:\t%d%%\n", stats->fragmentation);
+    if (stats->faults > 0) {
+        USLOSS_Console("\tfaultLatency:\t%d\n", stats->faultWait / stats->faults);
+    }
+    USLOSS_Console("\tpreZeroed:\t%d\n", stats->preZeroed);
+    USLOSS_Console("\tzeroedInline:\t%d\n", stats->zeroedInline);
+    USLOSS_Console("\tpinnedFrames:\t%d\n", stats->pinnedFrames);
+    USLOSS_Console("\tprefetched:\t%d\n", stats->prefetched);
+    USLOSS_Console("\tprefetchWasted:\t%d\n", stats->prefetchWasted);
+    USLOSS_Console("\tprocSwapOuts:\t%d\n", stats->procSwapOuts);
+    USLOSS_Console("\tprocSwapPages:\t%d\n", stats->procSwapPages);
+    USLOSS_Console("\tprocSwapIns:\t%d\n", stats->procSwapIns);
+    USLOSS_Console("\tmappedPages:\t%d\n", stats->mappedPages);
+    USLOSS_Console("\tmapWrites:\t%d\n", stats->mapWrites);
+    USLOSS_Console("\tsoftFaults:\t%d\n", stats->softFaults);
+    USLOSS_Console("\thardFaults:\t%d\n", stats->hardFaults);
+    USLOSS_Console("\trefaults:\t%d\n", stats->refaults);
+    USLOSS_Console("\twakePrefetched:\t%d\n", stats->wakePrefetched);
+    USLOSS_Console("\tprocSwapFails:\t%d\n", stats->procSwapFails);
 }
 
+/*
+ * Writes a snapshot of P3_vmStats to file, as one CSV row or one line of JSON, with the time
+ * (USLOSS_Clock) first. A CSV header row is written first if file is at its start. The JSON
+ * object also has a "procs" array with the P3_procStats of each process that has faulted;
+ * the CSV only has the totals. It does file I/O, so it must be called from a process, not
+ * an interrupt handler; the counters are read without locks.
+ */
+void
+P3_StatsDump(FILE *file, int format)
+{
+    StatsWrite(file, format, USLOSS_Clock(), &P3_vmStats, P3_procStats);
+}
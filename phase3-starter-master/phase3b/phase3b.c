@@ -12,21 +12,181 @@
 
 #include "phase3.h"
 #include "phase3Int.h"
+#include "phase3Trace.h"
 
-#ifdef DEBUG
-int debugging3 = 1;
-#else
-int debugging3 = 0;
-#endif
+static int  initialized = FALSE;
+static int  numFrames;
+static int  numPages;
+static int  pageSize;
+static void *pmAddr;
 
-void debug3(char *fmt, ...)
+/*
+ * Frame states. A free frame is on the stack for its state, so taking one or putting one
+ * back is O(1) whatever the number of frames. A frame freed while it still has swap I/O
+ * outstanding (e.g. the write of the page that was in it) is in transit until phase3c says
+ * the I/O is done (P3FrameIoDone); it is only handed out if there are no idle free frames,
+ * since whatever is put in it has to wait for the I/O, and it is never zeroed ahead of
+ * time. Frames in use that are pinned or have I/O outstanding are kept from being
+ * replaced by phase3c, and so are the free frames, which phase3c is told about as they go
+ * on and off the stacks (P3FrameFreeSet). Like the rest of the VM, all of this is
+ * protected by the VM lock, so any number of pagers can use it.
+ */
+#define FRAME_FREE      0   // free, not zeroed
+#define FRAME_ZEROED    1   // free and zeroed (P3FrameZeroFree)
+#define FRAME_TRANSIT   2   // free, swap I/O outstanding
+#define FRAME_USED      3   // holds a page
+#define FRAME_STACKS    3   // # of states with a stack
+
+typedef struct FrameStack {
+    int *frames;
+    int count;
+} FrameStack;
+
+static FrameStack   stacks[FRAME_STACKS];
+static int          *frameState;
+static int          *stackIndex;    // where a free frame is in its stack
+
+static void
+FramePush(int frame, int state)
+{
+    FrameStack *stack = &stacks[state];
+
+    frameState[frame] = state;
+    stackIndex[frame] = stack->count;
+    stack->frames[stack->count++] = frame;
+    P3FrameFreeSet(frame, TRUE);
+}
+
+// takes frame off its stack, the top frame fills its place
+static void
+FrameRemove(int frame)
+{
+    FrameStack *stack = &stacks[frameState[frame]];
+    int top;
+
+    assert(frameState[frame] != FRAME_USED);
+    top = stack->frames[--stack->count];
+    stack->frames[stackIndex[frame]] = top;
+    stackIndex[top] = stackIndex[frame];
+    frameState[frame] = FRAME_USED;
+    P3FrameFreeSet(frame, FALSE);
+}
+
+// the frame on top of the stack for state, -1 if there isn't one
+static int
+FrameTop(int state)
+{
+    FrameStack *stack = &stacks[state];
+
+    return stack->count > 0 ? stack->frames[stack->count - 1] : -1;
+}
+
+/*
+ * Takes a frame for pid from the pool of free frames, or evicts a page with P3SwapOut if
+ * there aren't any. If pid is at its frame limit one of its own pages is evicted instead;
+ * only if all of its frames are pinned does it go over its limit and get a frame like any
+ * other process. A new page (zero is TRUE) gets a frame that has already been zeroed if
+ * there is one; other pages get one that hasn't, to leave the zeroed frames for new pages.
+ * *zeroed is set to TRUE if the frame has been zeroed. If exact is TRUE only a free frame
+ * that is zeroed as asked will do, nothing is evicted, and P3_PAGE_NOT_FOUND is returned
+ * if there isn't one or pid is at its limit.
+ */
+static int
+FrameGet(int pid, int *frame, int zero, int exact, int *zeroed)
 {
-    va_list ap;
+    int found = -1;
+    int limited;
+    int rc;
 
-    if (debugging3) {
-        va_start(ap, fmt);
-        USLOSS_VConsole(fmt, ap);
+    *zeroed = FALSE;
+    rc = P3FrameLimitReached(pid, &limited);
+    assert(rc == P1_SUCCESS);
+    if (limited) {
+        if (exact) {
+            return P3_PAGE_NOT_FOUND;
+        }
+        rc = P3SwapOut(pid, frame);
+        if (rc != P3_PAGE_NOT_FOUND) {
+            return rc;
+        }
+    }
+    found = FrameTop(zero ? FRAME_ZEROED : FRAME_FREE);
+    if ((found == -1) && !exact) {
+        found = FrameTop(zero ? FRAME_FREE : FRAME_ZEROED);
+        if (found == -1) {
+            found = FrameTop(FRAME_TRANSIT);
+        }
     }
+    if (found != -1) {
+        *zeroed = frameState[found] == FRAME_ZEROED;
+        FrameRemove(found);
+        P3_vmStats.freeFrames--;
+        *frame = found;
+        return P1_SUCCESS;
+    }
+    if (exact) {
+        return P3_PAGE_NOT_FOUND;
+    }
+    // a process over its limit has nothing of its own to give up, the frame can come from any
+    rc = P3SwapOut(limited ? -1 : pid, frame);
+    return rc;
+}
+
+// P3PageFaultResolve and P3PagePrefetch, which only brings in a new page if it can have a
+// frame that is already zeroed
+static int
+PageResolve(int pid, int page, int *frame, int prefetch)
+{
+    int rc;
+    int found;
+    int zeroed;
+
+    if (!initialized) {
+        return P3_NOT_INITIALIZED;
+    }
+    if ((pid < 0) || (pid >= P1_MAXPROC)) {
+        return P1_INVALID_PID;
+    }
+    if ((page < 0) || (page >= numPages)) {
+        return P3_INVALID_PAGE;
+    }
+    // a shared page may already be in memory for another process
+    rc = P3SharedFrameGet(pid, page, frame);
+    if ((rc == P1_SUCCESS) || (rc == P3_IO_PENDING)) {
+        return rc;
+    }
+    // an inactive page is still in its frame and just has to be mapped back
+    rc = P3InactiveGet(pid, page, frame);
+    if (rc == P1_SUCCESS) {
+        if (!prefetch) {
+            P3_vmStats.softFaults++;
+        }
+        return rc;
+    }
+    // a new page should get a frame that is already zeroed
+    rc = P3SwapFind(pid, page, &found);
+    assert(rc == P1_SUCCESS);
+    rc = FrameGet(pid, frame, !found, prefetch && !found, &zeroed);
+    if (rc != P1_SUCCESS) {
+        return rc;
+    }
+    if (!prefetch) {
+        P3_vmStats.hardFaults++;
+    }
+    rc = P3SwapIn(pid, page, *frame);
+    if (rc == P3_PAGE_NOT_FOUND) {
+        P3_TP(P3_TP_NEW_PAGE, pid, page, *frame, -1, zeroed);
+        P3_vmStats.newPages++;
+        P3_procStats[pid].newPages++;
+        if (zeroed) {
+            P3_vmStats.preZeroed++;
+            rc = P1_SUCCESS;
+        } else {
+            P3_vmStats.zeroedInline++;
+            rc = P3FrameZero(*frame);
+        }
+    }
+    return rc;
 }
 
 /*
@@ -46,13 +206,122 @@ int
 P3FrameInit(int pages, int frames)
 {
     int result = P1_SUCCESS;
+    void *vmRegion;
+    int mmuPages, mmuFrames, mode;
+    int rc;
+
+    if (initialized) {
+        return P3_ALREADY_INITIALIZED;
+    }
+    rc = USLOSS_MmuGetConfig(&vmRegion, &pmAddr, &pageSize, &mmuPages, &mmuFrames, &mode);
+    assert(rc == USLOSS_MMU_OK);
+    numFrames = frames;
+    numPages = pages;
 
     // initialize the frame data structures, e.g. the pool of free frames
+    for (int i = 0; i < FRAME_STACKS; i++) {
+        stacks[i].frames = (int *) malloc(frames * sizeof(int));
+        stacks[i].count = 0;
+    }
+    frameState = (int *) malloc(frames * sizeof(int));
+    stackIndex = (int *) malloc(frames * sizeof(int));
+    // pushed from the top down so the low frames are handed out first
+    for (int i = frames - 1; i >= 0; i--) {
+        FramePush(i, FRAME_FREE);
+    }
     // set P3_vmStats.freeFrames
-
+    P3_vmStats.freeFrames = frames;
+    initialized = TRUE;
     return result;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3FrameFree --
+ *
+ *  Returns a frame to the pool of free frames. Used when a frame is
+ *  no longer mapped by any page, e.g. after its page was merged with
+ *  an identical page in another frame.
+ *
+ *----------------------------------------------------------------------
+ */
+void
+P3FrameFree(int frame)
+{
+    int busy;
+    int rc;
+
+    assert(initialized);
+    assert((frame >= 0) && (frame < numFrames));
+    assert(frameState[frame] == FRAME_USED);
+    rc = P3FrameBusy(frame, &busy);
+    assert(rc == P1_SUCCESS);
+    FramePush(frame, busy ? FRAME_TRANSIT : FRAME_FREE);
+    P3_vmStats.freeFrames++;
+    P3FrameFreed();
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3FrameIoDone --
+ *
+ *  Called by phase3c when the last swap I/O on a frame is done. If the
+ *  frame is free it is no longer in transit and goes back on the free
+ *  stack.
+ *
+ *----------------------------------------------------------------------
+ */
+void
+P3FrameIoDone(int frame)
+{
+    assert(initialized);
+    assert((frame >= 0) && (frame < numFrames));
+    if (frameState[frame] == FRAME_TRANSIT) {
+        FrameRemove(frame);
+        FramePush(frame, FRAME_FREE);
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3FrameZeroFree --
+ *
+ *  Zeroes a free frame that hasn't been zeroed yet, so that a later new
+ *  page can have it without being zeroed during the fault. Frames in
+ *  transit are left alone. *zeroed is set to TRUE if a frame was zeroed,
+ *  FALSE if there are none left to do.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:    P3FrameInit has not been called
+ *   P1_SUCCESS:            success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3FrameZeroFree(int *zeroed)
+{
+    int frame;
+    int rc;
+
+    if (!initialized) {
+        return P3_NOT_INITIALIZED;
+    }
+    *zeroed = FALSE;
+    frame = FrameTop(FRAME_FREE);
+    if (frame != -1) {
+        // frames in transit aren't on this stack, so it can't be busy
+        rc = P3FrameScrub(frame);
+        assert(rc == P1_SUCCESS);
+        FrameRemove(frame);
+        FramePush(frame, FRAME_ZEROED);
+        *zeroed = TRUE;
+    }
+    return P1_SUCCESS;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -72,9 +341,32 @@ int
 P3FrameFreeAll(int pid)
 {
     int result = P1_SUCCESS;
+    USLOSS_PTE *table;
+    int mapped;
+    int rc;
 
+    if (!initialized) {
+        return P3_NOT_INITIALIZED;
+    }
     // free all frames in use by the process (P3PageTableGet)
-
+    rc = P3PageTableGet(pid, &table);
+    if (rc != P1_SUCCESS) {
+        return rc;
+    }
+    if (table == NULL) {
+        return result;
+    }
+    for (int page = 0; page < numPages; page++) {
+        if (table[page].incore) {
+            // a frame shared with other pages stays allocated
+            rc = P3FrameUnmap(pid, page, table[page].frame, &mapped);
+            assert(rc == P1_SUCCESS);
+            if (mapped == 0) {
+                P3FrameFree(table[page].frame);
+            }
+            table[page].incore = 0;
+        }
+    }
     return result;
 }
 
@@ -83,7 +375,7 @@ P3FrameFreeAll(int pid)
  *
  * P3PageFaultResolve --
  *
- *  Frees all frames used by a process
+ *  Finds a frame for a page that is not in memory and fills it
  *
  * Results:
  *   P3_NOT_INITIALIZED:    P3FrameInit has not been 
@@ -91,6 +383,9 @@ P3FrameFreeAll(int pid)
  *   P1_INVALID_PID:        pid is invalid
  *   P1_INVALID_PAGE:       page is invalid
  *   P3_OUT_OF_SWAP:        there is no more swap space
+ *   P3_FRAMES_BUSY:        every frame has swap I/O outstanding
+ *   P3_IO_PENDING:         the page is being brought in, the fault is
+ *                          finished when it is done (P3PageFaultDone)
  *   P1_SUCCESS:            success
  *
  *----------------------------------------------------------------------
@@ -107,9 +402,120 @@ P3PageFaultResolve(int pid, int page, int *frame)
             return rc
     rc = P3SwapIn(pid, page, frame)
     if rc == P3_PAGE_NOT_FOUND
-        fill frame with zeros
-    return P1_SUCCESS
+        fill frame with zeros (P3FrameZero)
+    return rc
     *******************/
-    return P3_NOT_IMPLEMENTED;
+    return PageResolve(pid, page, frame, FALSE);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3PagePrefetch --
+ *
+ *  Brings a page into a frame ahead of a fault on it. A page in swap
+ *  gets a frame the way a fault would; a new page only gets a free frame
+ *  that has already been zeroed, so bringing it in early costs nothing
+ *  but the frame.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:    P3FrameInit has not been called
+ *   P1_INVALID_PID:        pid is invalid
+ *   P3_INVALID_PAGE:       page is invalid
+ *   P3_PAGE_NOT_FOUND:     the page is new and there is no zeroed frame
+ *   P3_OUT_OF_SWAP:        there is no more swap space
+ *   P3_FRAMES_BUSY:        every frame has swap I/O outstanding
+ *   P3_IO_PENDING:         the page is being brought in, P3PageFaultDone
+ *                          is called when it is done
+ *   P1_SUCCESS:            success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3PagePrefetch(int pid, int page, int *frame)
+{
+    return PageResolve(pid, page, frame, TRUE);
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3CowFaultResolve --
+ *
+ *  Handles a write to a page that is mapped read-only because it shares
+ *  its frame with other pages. If the page is the only one left in the
+ *  frame it simply becomes writable again, otherwise it gets its own
+ *  copy of the frame.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:    P3FrameInit has not been called
+ *   P1_INVALID_PID:        pid is invalid
+ *   P3_INVALID_PAGE:       page is invalid
+ *   P3_ACCESS_VIOLATION:   the page is not a shared page
+ *   P3_OUT_OF_SWAP:        there is no more swap space
+ *   P3_FRAMES_BUSY:        every frame has swap I/O outstanding
+ *   P3_IO_PENDING:         the copy is queued behind a write of the new
+ *                          frame, the fault is finished when it is done
+ *   P1_SUCCESS:            success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3CowFaultResolve(int pid, int page, int *frame)
+{
+    USLOSS_PTE *table;
+    char *copy;
+    int old;
+    int mapped;
+    int zeroed;
+    int rc;
+
+    if (!initialized) {
+        return P3_NOT_INITIALIZED;
+    }
+    if ((page < 0) || (page >= numPages)) {
+        return P3_INVALID_PAGE;
+    }
+    rc = P3PageTableGet(pid, &table);
+    if (rc != P1_SUCCESS) {
+        return rc;
+    }
+    if ((table == NULL) || !table[page].incore || table[page].write) {
+        return P3_ACCESS_VIOLATION;
+    }
+    old = table[page].frame;
+    rc = P3FrameUnmap(pid, page, old, &mapped);
+    assert(rc == P1_SUCCESS);
+    if (mapped == 0) {
+        // last page in the frame, it can have it to itself
+        rc = P3FrameMap(pid, page, old);
+        assert(rc == P1_SUCCESS);
+        *frame = old;
+        return P1_SUCCESS;
+    }
+    // copy the page out first, P3SwapOut may pick the old frame. The copy may have to
+    // wait for the new frame's previous page to be written out, so it gets its own buffer.
+    copy = (char *) malloc(pageSize);
+    memcpy(copy, pmAddr + old * pageSize, pageSize);
+    table[page].incore = 0;
+    rc = FrameGet(pid, frame, FALSE, FALSE, &zeroed);
+    if (rc != P1_SUCCESS) {
+        free(copy);
+        if (rc == P3_FRAMES_BUSY) {
+            // nothing was evicted, stay in the old frame until the fault is retried
+            rc = P3FrameMap(pid, page, old);
+            assert(rc == P1_SUCCESS);
+            table[page].incore = 1;
+            return P3_FRAMES_BUSY;
+        }
+        return rc;
+    }
+    P3_TP(P3_TP_COW, pid, page, *frame, -1, old);
+    rc = P3FrameMap(pid, page, *frame);
+    assert(rc == P1_SUCCESS);
+    // the copy may be newer than what's in swap for this page
+    rc = USLOSS_MmuSetAccess(*frame, USLOSS_MMU_REF | USLOSS_MMU_DIRTY);
+    assert(rc == USLOSS_MMU_OK);
+    P3_vmStats.cowFaults++;
+    return P3FrameCopy(*frame, copy);
+}
@@ -0,0 +1,153 @@
+/*
+ * bench.h
+ *
+ *  Common code for the VM benchmarks. Each benchmark defines BENCH_NAME, includes this
+ *  file, and defines Setup, which runs once before the children are spawned, and
+ *  NextPage, which returns the page a child touches next and whether it writes it.
+ *  Each child touches one word of a page per reference. When the children are done
+ *  the benchmark prints one row of the table "make bench" puts together:
+ *
+ *      workload faults newPages pageIns pageOuts replaced time(us)
+ *
+ *  The workload is parameterized with name=value arguments, e.g.
+ *
+ *      make bench BENCHFLAGS="pages=64 frames=16 children=4 refs=1000 seed=7"
+ *
+ *  trace=file records the benchmark's faults in file for tools/replay (phase3Trace.h).
+ *  stats=file writes JSON snapshots of the statistics to file every STATS_INTERVAL clock
+ *  interrupts (P3_StatsDump), for graphing them over time or diffing two runs.
+ *  The VM itself is tuned with the P3_VM_OPTIONS environment variable (P3_VmOptions); the
+ *  background processes are all off unless it turns them on, e.g.
+ *
+ *      P3_VM_OPTIONS="swapSched=fifo dedupInterval=1 zeroFrames=true" make bench
+ *
+ */
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include <usyscall.h>
+#include <libuser.h>
+#include <assert.h>
+#include <usloss.h>
+#include <stdlib.h>
+#include <phase3.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase3Int.h"
+
+#define PAGERS 1        // # of pagers
+#define STATS_INTERVAL 5    // clock interrupts between statistics snapshots
+
+// A child's position in its workload.
+typedef struct BenchState {
+    int         child;  // which child, 0 .. children - 1
+    int         ref;    // # of references made so far
+    unsigned    seed;   // for rand_r
+} BenchState;
+
+static int  pages = 32;     // # of pages per process
+static int  frames = 8;
+static int  children = 2;
+static int  refs = 2000;    // # of references per child
+static int  seed = 1;
+static char trace[256];     // fault trace file, empty if none
+static char stats[256];     // statistics snapshot file, empty if none
+
+static char *vmRegion;
+static int  pageSize;
+static int  passed = FALSE;
+
+static void Setup(void);
+static int  NextPage(BenchState *state, int *write);
+
+static int
+Child(void *arg)
+{
+    BenchState      state;
+    volatile int    *word;  // volatile so the reads aren't optimized away
+    int             page;
+    int             write;
+    int             value;
+
+    state.child = (int) arg;
+    state.seed = seed + state.child;
+    for (state.ref = 0; state.ref < refs; state.ref++) {
+        page = NextPage(&state, &write);
+        assert((page >= 0) && (page < pages));
+        word = (volatile int *) (vmRegion + page * pageSize) + state.ref % (pageSize / sizeof(int));
+        if (write) {
+            *word = state.ref;
+        } else {
+            value = *word;
+        }
+    }
+    return 0;
+}
+
+int
+P4_Startup(void *arg)
+{
+    int     i;
+    int     rc;
+    int     pid;
+    int     status;
+    int     start;
+
+    rc = Sys_VmInit(pages, pages, frames, PAGERS, (void **) &vmRegion, &pageSize);
+    TEST(rc, P1_SUCCESS);
+    Setup();
+    start = USLOSS_Clock();
+    for (i = 0; i < children; i++) {
+        rc = Sys_Spawn(BENCH_NAME, Child, (void *) i, USLOSS_MIN_STACK * 4, 3, &pid);
+        assert(rc == P1_SUCCESS);
+    }
+    for (i = 0; i < children; i++) {
+        rc = Sys_Wait(&pid, &status);
+        assert(rc == P1_SUCCESS);
+        TEST(status, 0);
+    }
+    USLOSS_Console("BENCH %-10s %8d %8d %8d %8d %8d %10d\n", BENCH_NAME, P3_vmStats.faults,
+                   P3_vmStats.newPages, P3_vmStats.pageIns, P3_vmStats.pageOuts,
+                   P3_vmStats.replaced, USLOSS_Clock() - start);
+    Sys_VmShutdown();
+    passed = TRUE;
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        sscanf(argv[i], "pages=%d", &pages);
+        sscanf(argv[i], "frames=%d", &frames);
+        sscanf(argv[i], "children=%d", &children);
+        sscanf(argv[i], "refs=%d", &refs);
+        sscanf(argv[i], "seed=%d", &seed);
+        sscanf(argv[i], "trace=%255s", trace);
+        sscanf(argv[i], "stats=%255s", stats);
+    }
+    if (trace[0] != '\0') {
+        P3_faultTrace = trace;
+    }
+    if (stats[0] != '\0') {
+        P3_statsFile = stats;
+        P3_statsFormat = P3_STATS_JSON;
+        P3_statsInterval = STATS_INTERVAL;
+    }
+    DeleteAllDisks();
+    // room for every page of every child
+    int rc = Disk_Create(NULL, P3_SWAP_DISK, children * pages);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        PASSED_FINISH();
+    }
+}
+
+void finish(int argc, char **argv) {}
+
+#endif
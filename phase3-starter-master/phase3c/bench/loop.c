@@ -0,0 +1,28 @@
+/*
+ * loop.c
+ *
+ *  Loop slightly larger than memory: the children together loop over one more page
+ *  each than their share of the frames, writing every page. This is the worst case
+ *  for LRU-like replacement, which evicts each page just before it is needed again.
+ *
+ */
+#define BENCH_NAME "loop"
+#include "bench.h"
+
+static int  length;     // # of pages each child loops over
+
+static void
+Setup(void)
+{
+    length = frames / children + 1;
+    if (length > pages) {
+        length = pages;
+    }
+}
+
+static int
+NextPage(BenchState *state, int *write)
+{
+    *write = TRUE;
+    return state->ref % length;
+}
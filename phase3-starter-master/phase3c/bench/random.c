@@ -0,0 +1,21 @@
+/*
+ * random.c
+ *
+ *  Random uniform: each child touches pages chosen uniformly at random, writing half
+ *  of them.
+ *
+ */
+#define BENCH_NAME "random"
+#include "bench.h"
+
+static void
+Setup(void)
+{
+}
+
+static int
+NextPage(BenchState *state, int *write)
+{
+    *write = rand_r(&state->seed) % 2;
+    return rand_r(&state->seed) % pages;
+}
@@ -0,0 +1,21 @@
+/*
+ * scan.c
+ *
+ *  Read-mostly scan: each child first writes every page once, then scans them in
+ *  order reading, with one reference in sixteen a write.
+ *
+ */
+#define BENCH_NAME "scan"
+#include "bench.h"
+
+static void
+Setup(void)
+{
+}
+
+static int
+NextPage(BenchState *state, int *write)
+{
+    *write = (state->ref < pages) || (state->ref % 16 == 0);
+    return state->ref % pages;
+}
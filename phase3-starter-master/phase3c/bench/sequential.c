@@ -0,0 +1,20 @@
+/*
+ * sequential.c
+ *
+ *  Sequential sweep: each child writes its pages in order, over and over.
+ *
+ */
+#define BENCH_NAME "sequential"
+#include "bench.h"
+
+static void
+Setup(void)
+{
+}
+
+static int
+NextPage(BenchState *state, int *write)
+{
+    *write = TRUE;
+    return state->ref % pages;
+}
@@ -0,0 +1,35 @@
+/*
+ * stride.c
+ *
+ *  Strided walk: each child writes its pages once, then reads them STRIDE pages apart,
+ *  starting over one page further on each time it runs off the end, like a loop down the
+ *  columns of a matrix stored a row per page. One reference in sixteen is a write.
+ *
+ */
+#define BENCH_NAME "stride"
+#include "bench.h"
+
+#define STRIDE 3
+
+static void
+Setup(void)
+{
+}
+
+static int
+NextPage(BenchState *state, int *write)
+{
+    int i = (state->ref - pages) % pages;   // how far into the current walk
+    int start;
+
+    if (state->ref < pages) {
+        *write = TRUE;
+        return state->ref;
+    }
+    *write = (state->ref % 16 == 0);
+    // the walk from start has (pages - start + STRIDE - 1) / STRIDE pages
+    for (start = 0; i >= (pages - start + STRIDE - 1) / STRIDE; start++) {
+        i -= (pages - start + STRIDE - 1) / STRIDE;
+    }
+    return start + i * STRIDE;
+}
@@ -0,0 +1,46 @@
+/*
+ * zipf.c
+ *
+ *  Zipfian hot set: page i is touched with probability proportional to 1 / (i + 1), so
+ *  a few pages get most of the references. A quarter of the references are writes.
+ *
+ */
+#define BENCH_NAME "zipf"
+#include "bench.h"
+
+static double *cdf;     // cdf[i] is the probability of touching a page <= i
+
+static void
+Setup(void)
+{
+    double  total = 0.0;
+    int     i;
+
+    cdf = (double *) malloc(pages * sizeof(double));
+    for (i = 0; i < pages; i++) {
+        total += 1.0 / (i + 1);
+        cdf[i] = total;
+    }
+    for (i = 0; i < pages; i++) {
+        cdf[i] /= total;
+    }
+}
+
+static int
+NextPage(BenchState *state, int *write)
+{
+    double  u = (double) rand_r(&state->seed) / RAND_MAX;
+    int     low = 0, high = pages - 1, mid;
+
+    *write = (rand_r(&state->seed) % 4) == 0;
+    // first page whose cdf is >= u
+    while (low < high) {
+        mid = (low + high) / 2;
+        if (cdf[mid] < u) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
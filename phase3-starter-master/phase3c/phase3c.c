@@ -13,342 +13,2920 @@
 
 #include "phase3.h"
 #include "phase3Int.h"
+#include "phase3Trace.h"
 
-#ifdef DEBUG
-static int debugging3 = 1;
-#else
-static int debugging3 = 0;
-#endif
+// number of words compared per step when checking for a same-filled page
+#define FILL_CHUNK 8
+
+#define SWAP_READ 0
+#define SWAP_WRITE 1
+#define SWAP_FILL 2
+#define SWAP_COPY 3
 
 int numFrames;
 int numBlocks;
 int sectorsInBlock;
 int initialized;
 
+static int numPages;
+static int pageSize;
+
+// another (pid, page) mapped to a frame, see memory_node.sharers
+typedef struct frame_map{
+    int pid;
+    int page;
+    struct frame_map *next;
+} frame_map;
+
+struct shared_region;
+
 typedef struct memory_node{
     int pid; // NOTE: Might not be important, the pid of the page
     int page; // what page is being stored here
     int frame; // frame in the clock, SHOULD NOT CHANGE
     void *frame_address;
-    memory_node *next;
+    frame_map *sharers; // other pages in this frame: merged (read-only) or, if region is set, attached
+    unsigned long hash; // contents hash from the last dedup scan
+    struct shared_region *region; // shared region the frame's page belongs to, NULL if none
+    int region_page; // which page of the region
+    int io; // swap requests outstanding on the frame, it can't be replaced until they finish
+    int filling; // the frame's page is being read or filled in for a fault
+    frame_map *waiters; // other faults on the page waiting for it to be filled in
+    int pins; // pinned pages in the frame (P3FramePin), it can't be replaced or merged
+    int inactive; // the page is unmapped but still in the frame, on the inactive list
+    struct memory_node *inactive_prev; // toward the head of the inactive list
+    struct memory_node *inactive_next; // toward the tail, which is reclaimed first
+    struct memory_node *next;
 } memory_node;
 
 typedef struct swap_space{
     int pid;
     int page;
     int block; // block number, calculated using sector size
-    int sector; 
-    swap_space *next;
+    int unit; // which of the swap units the block is on, index into units
+    int sector;
+    int refs; // number of swap map entries using the block
+    int writes; // bumped whenever the block is allocated or written, see BlockMove
+    int mapped; // a block of a disk mapping (P3MapCreate) rather than of swap
+    struct swap_space *next;
 } swap_space;
 
+// The swap map has one entry per (pid, page) and records where the page is kept while
+// it is not in a frame: either in a block on the swap disk, or, if every word of the page
+// was the same, as just that fill value with no block at all. It also keeps a shadow of
+// the page after it is evicted, the eviction count at the time.
+// A page in a shared region is kept in the region's own entry instead, and the (pid, page)
+// entries of the attached processes just point at it.
+typedef struct swap_entry{
+    swap_space *block; // block holding the page, NULL if none
+    int filled; // page is stored as a fill value
+    unsigned long fill; // value repeated across the whole page
+    struct shared_region *region; // shared region the page is attached to, NULL if private
+    int region_page; // which page of the region
+    memory_node *inactive; // frame the page is still in while on the inactive list, NULL if none
+    unsigned long shadow; // evictions when the page was last evicted, 0 if it wasn't or the
+                          // entry was changed since (Refault)
+} swap_entry;
+
+// pages shared by several processes (P3_VmShare/P3_VmAttach)
+typedef struct shared_region{
+    int in_use;
+    int pages; // number of pages in the region
+    int refs; // number of processes attached
+    int attached[P1_MAXPROC]; // TRUE if the process is attached
+    int *frames; // frame holding each page, -1 if not in memory
+    swap_entry *entries; // where each page is kept while not in a frame
+} shared_region;
+
+// A read or write of one block, or a fill of a frame, waiting in a swap unit's queue. The
+// pager queues it and goes on to the next fault; the unit's SwapDisk process does the
+// transfer and finishes the fault. Requests on the same frame run in the order they were
+// queued, even across units.
+typedef struct swap_request{
+    int op; // SWAP_READ, SWAP_WRITE, SWAP_FILL or SWAP_COPY
+    int unit; // index into units
+    int seq; // order the request was queued in
+    int sector;
+    memory_node *node; // frame read into or written from
+    unsigned long fill; // value for SWAP_FILL
+    void *buffer; // page for SWAP_COPY, freed when done
+    int fault; // the frame's page is being brought in for a fault
+    int submitted; // USLOSS_Clock when it was queued
+    struct swap_request *next;
+} swap_request;
+
 memory_node *head_memory;
 swap_space *head_disk;
+swap_entry *swap_map;
+static shared_region regions[P3_MAX_REGIONS];
+
+// One of the disk units used for swap. Blocks are striped across the units and each unit
+// has its own queue and SwapDisk process, so transfers on different units overlap. A unit
+// with disk mappings on it (P3MapCreate) gets a queue and SwapDisk process the same way,
+// after the swap units, but none of its blocks are used for swap.
+typedef struct swap_unit{
+    int unit; // disk unit number
+    swap_request *queue;
+    swap_request *active; // requests being transferred
+    int pending; // signalled when a request is queued or a write finishes
+    int head_sector; // where the disk head was left
+    char *cluster_buffer; // holds merged requests for one transfer
+    int blocks; // number of blocks on the unit
+    swap_space **slots; // the unit's blocks in sector order
+} swap_unit;
+
+int P3_swapSched = P3_SCHED_CSCAN;
+int P3_inactivePercent = 0;
+static swap_unit units[USLOSS_DISK_UNITS];
+static int numUnits; // swap units
+static int numIOUnits; // swap units and then units with mappings
+static int io_lock; // protects every unit's queue
+static int io_shutdown;
+static int io_seq;
+static char *compact_buffer; // holds a block while compaction moves it
+
+// The clock's copy of the frames' reference bits (see AccessHarvest), and the frames with
+// I/O outstanding, one bit per frame. The clock scans them a word at a time instead of
+// asking the MMU about every frame it passes. Bits past the last frame are set in
+// io_busy so they are never picked.
+#define WORD_BITS ((int) (8 * sizeof(unsigned long)))
+static unsigned long *ref_shadow;
+static unsigned long *io_busy;
+static unsigned long *pinned; // frames with pins, skipped like the busy ones
+static unsigned long *inactive_map; // frames on the inactive list, skipped too
+static unsigned long *free_map; // frames in phase3b's free pool (P3FrameFreeSet), skipped too
+static int map_words;
+
+static memory_node **frame_nodes; // the frame list indexed by frame
+// Frames owned by each process (memory_node.pid), and the most it may have, 0 for no
+// limit. A process at its limit replaces one of its own pages (LocalVictim).
+static int resident[P1_MAXPROC];
+static int frame_limit[P1_MAXPROC];
+static int local_hand[P1_MAXPROC];
+static int clock_hand; // the frame the clock picked last
+// Pages the clock has unmapped but left in their frames, newest at the head. A fault on
+// one maps it back (P3InactiveGet); P3SwapOut reclaims the frame at the tail.
+static memory_node *inactive_head;
+static memory_node *inactive_tail;
+static int inactive_count;
+static int inactive_target; // P3_inactivePercent of the frames, 0 for no inactive list
+static unsigned long evictions; // pages evicted from frames so far, see Refault
+
+static void
+BitSet(unsigned long *map, int frame)
+{
+    map[frame / WORD_BITS] |= 1UL << (frame % WORD_BITS);
+}
+
+static void
+BitClear(unsigned long *map, int frame)
+{
+    map[frame / WORD_BITS] &= ~(1UL << (frame % WORD_BITS));
+}
+
+static int
+BitTest(unsigned long *map, int frame)
+{
+    return (map[frame / WORD_BITS] >> (frame % WORD_BITS)) & 1;
+}
+
+static memory_node *
+FrameNode(int frame)
+{
+    return frame_nodes[frame];
+}
+
+// makes pid the owner of node's frame, -1 for none, keeping count of each process's frames
+static void
+FrameOwnerSet(memory_node *node, int pid)
+{
+    if(node->pid != -1){
+        resident[node->pid]--;
+    }
+    if(pid != -1){
+        resident[pid]++;
+    }
+    node->pid = pid;
+}
+
+static swap_entry *
+SwapEntry(int pid, int page)
+{
+    return &swap_map[pid * numPages + page];
+}
+
+static swap_space *
+BlockAlloc(int pid, int page)
+{
+    swap_space *cur = head_disk;
+    while(cur != NULL && cur->pid != -1){
+        cur = cur->next;
+    }
+    if(cur != NULL){
+        cur->pid = pid;
+        cur->page = page;
+        cur->refs = 0;
+        cur->writes++;
+        P3_vmStats.freeBlocks--;
+    }
+    return cur;
+}
+
+// drops one reference to a block, freeing it when nobody uses it
+static void
+BlockFree(swap_space *block)
+{
+    block->refs--;
+    if(block->refs > 0){
+        return;
+    }
+    if(block->mapped){
+        // the disk block stays where it is, only the mapping goes
+        free(block);
+        return;
+    }
+    block->pid = -1;
+    block->page = -1;
+    P3_vmStats.freeBlocks++;
+}
+
+// makes a swap map entry use block, any shadow it had is for what was there before
+static void
+EntrySetBlock(swap_entry *entry, swap_space *block)
+{
+    entry->shadow = 0;
+    if(entry->block != block){
+        if(entry->block != NULL){
+            BlockFree(entry->block);
+        }
+        entry->block = block;
+        if(block != NULL){
+            block->refs++;
+        }
+    }
+    entry->filled = 0;
+}
+
+static void
+EntrySetFill(swap_entry *entry, unsigned long fill)
+{
+    entry->shadow = 0;
+    if(entry->block != NULL){
+        BlockFree(entry->block);
+        entry->block = NULL;
+    }
+    entry->filled = 1;
+    entry->fill = fill;
+}
+
+static int
+EntryEmpty(swap_entry *entry)
+{
+    return entry->block == NULL && !entry->filled;
+}
+
+static int
+EntryMapped(swap_entry *entry)
+{
+    return entry->block != NULL && entry->block->mapped;
+}
+
+// the entry a frame's contents are saved to
+static swap_entry *
+FrameEntry(memory_node *node)
+{
+    if(node->region != NULL){
+        return &node->region->entries[node->region_page];
+    }
+    return SwapEntry(node->pid, node->page);
+}
+
+static void
+PageUnmap(int pid, int page)
+{
+    USLOSS_PTE *table;
+    int rc;
+
+    rc = P3PageTableGet(pid, &table);
+    assert(rc == P1_SUCCESS);
+    // incore is the bit that sets if in frame, 0 means its not in frame
+    if(table != NULL){
+        table[page].incore = 0;
+    }
+}
+
+// FNV-1a over the words of a page
+static unsigned long
+PageHash(void *addr)
+{
+    unsigned long *words = (unsigned long *) addr;
+    int count = pageSize / sizeof(unsigned long);
+    unsigned long hash = 14695981039346656037UL;
+    int i;
+
+    for(i = 0; i < count; i++){
+        hash ^= words[i];
+        hash *= 1099511628211UL;
+    }
+    return hash;
+}
+
+static void
+SetWrite(int pid, int page, int frame, int write)
+{
+    USLOSS_PTE *table;
+    int rc;
+
+    rc = P3PageTableGet(pid, &table);
+    assert(rc == P1_SUCCESS);
+    assert(table != NULL);
+    table[page].frame = frame;
+    table[page].write = write;
+}
+
+// points every page in node at frame with the given write permission
+static void
+FrameProtect(memory_node *node, int frame, int write)
+{
+    frame_map *map;
+
+    SetWrite(node->pid, node->page, frame, write);
+    for(map = node->sharers; map != NULL; map = map->next){
+        SetWrite(map->pid, map->page, frame, write);
+    }
+}
+
+/*
+ * Returns TRUE if every word of the page is the same, and stores that word in *fill.
+ * The differences are OR'ed together a chunk at a time so the inner loop has no branches
+ * and can be vectorized, while a page that differs early still bails out early.
+ */
+static int
+PageIsFilled(void *addr, unsigned long *fill)
+{
+    unsigned long *words = (unsigned long *) addr;
+    int count = pageSize / sizeof(unsigned long);
+    unsigned long first = words[0];
+    unsigned long diff = 0;
+    int i, j;
+
+    for(i = 0; i + FILL_CHUNK <= count; i += FILL_CHUNK){
+        for(j = i; j < i + FILL_CHUNK; j++){
+            diff |= words[j] ^ first;
+        }
+        if(diff != 0){
+            return FALSE;
+        }
+    }
+    // leftover words if the page isn't a multiple of the chunk size
+    for(; i < count; i++){
+        diff |= words[i] ^ first;
+    }
+    if(diff != 0){
+        return FALSE;
+    }
+    *fill = first;
+    return TRUE;
+}
+
+static void
+PageFill(void *addr, unsigned long fill)
+{
+    unsigned long *words = (unsigned long *) addr;
+    unsigned char byte = fill & 0xff;
+    int count = pageSize / sizeof(unsigned long);
+    unsigned long repeated;
+    int i;
+
+    // a repeated byte (e.g. all zeros) can use memset
+    memset(&repeated, byte, sizeof(repeated));
+    if(fill == repeated){
+        memset(addr, byte, pageSize);
+        return;
+    }
+    for(i = 0; i < count; i++){
+        words[i] = fill;
+    }
+}
+
+// the newest queued or active write of a sector on a unit, NULL if none
+static swap_request *
+IOWriter(swap_unit *unit, int sector)
+{
+    swap_request *cur, *writer = NULL;
+
+    for(cur = unit->active; cur != NULL; cur = cur->next){
+        if(cur->op == SWAP_WRITE && cur->sector == sector){
+            writer = cur;
+        }
+    }
+    for(cur = unit->queue; cur != NULL; cur = cur->next){
+        if(cur->op == SWAP_WRITE && cur->sector == sector){
+            writer = cur;
+        }
+    }
+    return writer;
+}
+
+// a request can't start until the writes queued before it from the same frame are done,
+// on any unit, otherwise it would overwrite the page being written out
+static int
+IOReady(swap_request *request)
+{
+    swap_request *cur;
+    int i;
+
+    for(i = 0; i < numIOUnits; i++){
+        for(cur = units[i].active; cur != NULL; cur = cur->next){
+            if(cur->op == SWAP_WRITE && cur->node == request->node){
+                return FALSE;
+            }
+        }
+        for(cur = units[i].queue; cur != NULL; cur = cur->next){
+            if(cur->op == SWAP_WRITE && cur->node == request->node && cur->seq < request->seq){
+                return FALSE;
+            }
+        }
+    }
+    return TRUE;
+}
+
+static void
+IORemove(swap_request *request)
+{
+    swap_unit *unit = &units[request->unit];
+    swap_request **prev;
+
+    for(prev = &unit->queue; *prev != request; prev = &(*prev)->next){
+    }
+    *prev = request->next;
+    request->next = unit->active;
+    unit->active = request;
+}
+
+/*
+ * Picks the next requests to send to a unit and moves them from its queue to its active
+ * list. Fills, and reads of a block that is still being written (they are copied from the
+ * frame being written), don't use the disk and go by themselves. Otherwise C-SCAN takes
+ * the lowest sector at or past the head, wrapping to the lowest sector overall, then
+ * merges the requests for the following blocks with the same op into one transfer of up to
+ * P3_MAX_CLUSTER blocks. FIFO takes the oldest request by itself. Only requests that are
+ * ready (IOReady) are picked. Returns the number of requests in batch, in sector order, 0
+ * if nothing is ready. Called with io_lock held.
+ */
+static int
+IOSchedule(swap_unit *unit, swap_request **batch)
+{
+    swap_request *cur, *pick = NULL, *wrap = NULL;
+    swap_request *next;
+    int count;
+
+    for(cur = unit->queue; cur != NULL; cur = cur->next){
+        if(!IOReady(cur)){
+            continue;
+        }
+        if(cur->op == SWAP_FILL || cur->op == SWAP_COPY
+            || (cur->op == SWAP_READ && IOWriter(unit, cur->sector) != NULL)
+            || P3_swapSched == P3_SCHED_FIFO){
+            batch[0] = cur;
+            IORemove(cur);
+            return 1;
+        }
+        if(cur->sector >= unit->head_sector && (pick == NULL || cur->sector < pick->sector)){
+            pick = cur;
+        }
+        if(wrap == NULL || cur->sector < wrap->sector){
+            wrap = cur;
+        }
+    }
+    if(pick == NULL){
+        pick = wrap;
+    }
+    if(pick == NULL){
+        return 0;
+    }
+    batch[0] = pick;
+    IORemove(pick);
+    count = 1;
+    while(count < P3_MAX_CLUSTER){
+        next = NULL;
+        for(cur = unit->queue; cur != NULL; cur = cur->next){
+            if(cur->op == batch[0]->op && cur->sector == batch[count - 1]->sector + sectorsInBlock
+                && IOReady(cur) && (cur->op == SWAP_WRITE || IOWriter(unit, cur->sector) == NULL)){
+                next = cur;
+                break;
+            }
+        }
+        if(next == NULL){
+            break;
+        }
+        IORemove(next);
+        batch[count++] = next;
+    }
+    return count;
+}
+
+// counts a transfer on unit starting at sector, and the tracks the head moves to get there
+static void
+IOSeek(swap_unit *unit, int sector)
+{
+    int track = sector / USLOSS_DISK_TRACK_SIZE - unit->head_sector / USLOSS_DISK_TRACK_SIZE;
+
+    P3_vmStats.ioSeek += track < 0 ? -track : track;
+    P3_vmStats.ioTransfers++;
+}
+
+// does the transfer for a batch picked by IOSchedule
+static void
+IOTransfer(swap_unit *unit, swap_request **batch, int count)
+{
+    swap_request *writer;
+    int rc, i;
+
+    if(batch[0]->op == SWAP_FILL){
+        PageFill(batch[0]->node->frame_address, batch[0]->fill);
+        return;
+    }
+    if(batch[0]->op == SWAP_COPY){
+        memcpy(batch[0]->node->frame_address, batch[0]->buffer, pageSize);
+        free(batch[0]->buffer);
+        return;
+    }
+    if(batch[0]->op == SWAP_READ){
+        rc = P1_Lock(io_lock);
+        assert(rc == P1_SUCCESS);
+        writer = IOWriter(unit, batch[0]->sector);
+        rc = P1_Unlock(io_lock);
+        assert(rc == P1_SUCCESS);
+        if(writer != NULL){
+            // the block isn't on disk yet, but the frame it is being written from still has it
+            memcpy(batch[0]->node->frame_address, writer->node->frame_address, pageSize);
+            return;
+        }
+    }
+    IOSeek(unit, batch[0]->sector);
+    if(count == 1){
+        if(batch[0]->op == SWAP_WRITE){
+            rc = P2_DiskWrite(unit->unit, batch[0]->sector, sectorsInBlock, batch[0]->node->frame_address);
+        }
+        else{
+            rc = P2_DiskRead(unit->unit, batch[0]->sector, sectorsInBlock, batch[0]->node->frame_address);
+        }
+        assert(rc == P1_SUCCESS);
+    }
+    else if(batch[0]->op == SWAP_WRITE){
+        for(i = 0; i < count; i++){
+            memcpy(unit->cluster_buffer + i * pageSize, batch[i]->node->frame_address, pageSize);
+        }
+        rc = P2_DiskWrite(unit->unit, batch[0]->sector, count * sectorsInBlock, unit->cluster_buffer);
+        assert(rc == P1_SUCCESS);
+    }
+    else{
+        rc = P2_DiskRead(unit->unit, batch[0]->sector, count * sectorsInBlock, unit->cluster_buffer);
+        assert(rc == P1_SUCCESS);
+        for(i = 0; i < count; i++){
+            memcpy(batch[i]->node->frame_address, unit->cluster_buffer + i * pageSize, pageSize);
+        }
+    }
+    unit->head_sector = batch[count - 1]->sector + sectorsInBlock;
+}
+
+/*
+ * Finishes a request once its transfer is done. If it brought in a page for a fault, the
+ * faulting process, and any others waiting on the same shared page, get the page mapped
+ * and are woken up. Called with the VM lock held.
+ */
+static void
+IOComplete(swap_request *request)
+{
+    memory_node *node = request->node;
+    frame_map *map;
+
+    node->io--;
+    if(node->io == 0){
+        BitClear(io_busy, node->frame);
+    }
+    if(request->fault){
+        node->filling = FALSE;
+        if(node->pid != -1){
+            P3PageFaultDone(node->pid, node->page, node->frame);
+        }
+        while(node->waiters != NULL){
+            map = node->waiters;
+            P3PageFaultDone(map->pid, map->page, node->frame);
+            node->waiters = map->next;
+            free(map);
+        }
+    }
+    if(node->io == 0){
+        // a free frame is no longer in transit, and faults that found every frame busy can
+        // try again
+        P3FrameIoDone(node->frame);
+        P3FrameIdle();
+    }
+}
+
+/*
+ * Services one swap unit's queue, arg is the unit.
+ */
+static int
+SwapDisk(void *arg)
+{
+    swap_unit *unit = (swap_unit *) arg;
+    swap_request *batch[P3_MAX_CLUSTER];
+    swap_request **prev;
+    int count, rc, i;
+    int now;
+
+    while(1){
+        rc = P1_Lock(io_lock);
+        assert(rc == P1_SUCCESS);
+        while((count = IOSchedule(unit, batch)) == 0 && !(io_shutdown && unit->queue == NULL)){
+            rc = P1_Wait(unit->pending);
+            assert(rc == P1_SUCCESS);
+        }
+        rc = P1_Unlock(io_lock);
+        assert(rc == P1_SUCCESS);
+        if(count == 0){
+            break;
+        }
+
+        IOTransfer(unit, batch, count);
+
+        P3VmLock();
+        rc = P1_Lock(io_lock);
+        assert(rc == P1_SUCCESS);
+        now = USLOSS_Clock();
+        for(i = 0; i < count; i++){
+            for(prev = &unit->active; *prev != batch[i]; prev = &(*prev)->next){
+            }
+            *prev = batch[i]->next;
+            P3_vmStats.ioWait += now - batch[i]->submitted;
+        }
+        // requests that were waiting on these frames may be ready now, on any unit
+        for(i = 0; i < numIOUnits; i++){
+            rc = P1_Signal(units[i].pending);
+            assert(rc == P1_SUCCESS);
+        }
+        rc = P1_Unlock(io_lock);
+        assert(rc == P1_SUCCESS);
+        for(i = 0; i < count; i++){
+            IOComplete(batch[i]);
+            free(batch[i]);
+        }
+        P3VmUnlock();
+    }
+    return 0;
+}
+
+/*
+ * Queues a request on a frame for the SwapDisk process of unit and returns without waiting
+ * for it. Fills and copies don't use a disk, unit is -1 and they go on the queue of a unit
+ * the frame is being written to, if any. Called with the VM lock held.
+ */
+static swap_request *
+IOSubmit(int op, int unit, int sector, memory_node *node, unsigned long fill, int fault)
+{
+    swap_request *request;
+    swap_request *cur;
+    swap_request **prev;
+    int rc, i;
+
+    request = (swap_request *)malloc(sizeof(swap_request));
+    request->op = op;
+    request->unit = unit;
+    request->sector = sector;
+    request->node = node;
+    request->fill = fill;
+    request->buffer = NULL;
+    request->fault = fault;
+    request->next = NULL;
+    node->io++;
+    BitSet(io_busy, node->frame);
+    if(fault){
+        node->filling = TRUE;
+    }
+    rc = P1_Lock(io_lock);
+    assert(rc == P1_SUCCESS);
+    request->submitted = USLOSS_Clock();
+    request->seq = io_seq++;
+    if(unit == -1){
+        request->unit = 0;
+        for(i = 0; i < numIOUnits; i++){
+            for(cur = units[i].active; cur != NULL; cur = cur->next){
+                if(cur->op == SWAP_WRITE && cur->node == node){
+                    request->unit = i;
+                }
+            }
+            for(cur = units[i].queue; cur != NULL; cur = cur->next){
+                if(cur->op == SWAP_WRITE && cur->node == node){
+                    request->unit = i;
+                }
+            }
+        }
+    }
+    // queue is kept in arrival order, for FIFO
+    for(prev = &units[request->unit].queue; *prev != NULL; prev = &(*prev)->next){
+    }
+    *prev = request;
+    if(op == SWAP_READ || op == SWAP_WRITE){
+        P3_vmStats.ioRequests++;
+    }
+    rc = P1_Signal(units[request->unit].pending);
+    assert(rc == P1_SUCCESS);
+    rc = P1_Unlock(io_lock);
+    assert(rc == P1_SUCCESS);
+    return request;
+}
+
+/*
+ * Fills a frame with a value for a fault. It's done right away unless the frame still has
+ * a write outstanding, in which case it is queued behind it.
+ */
+static int
+FrameFill(memory_node *node, unsigned long fill)
+{
+    if(node->io == 0){
+        PageFill(node->frame_address, fill);
+        return P1_SUCCESS;
+    }
+    IOSubmit(SWAP_FILL, -1, 0, node, fill, TRUE);
+    return P3_IO_PENDING;
+}
+
+/*
+ * Saves a frame's contents to a swap map entry, either as a fill value or by writing it to
+ * the entry's block. The block is reused unless another entry still needs its contents.
+ */
+static int
+EntrySave(swap_entry *entry, memory_node *node)
+{
+    unsigned long fill;
+    swap_space *block;
+
+    // a mapped page always goes back to its own block on the mapped disk
+    if(!EntryMapped(entry) && PageIsFilled(node->frame_address, &fill)){
+        P3_TP(P3_TP_FILL, node->pid, node->page, node->frame, -1, (int) fill);
+        EntrySetFill(entry, fill);
+        P3_vmStats.fillPages++;
+        return P1_SUCCESS;
+    }
+    block = entry->block;
+    if(block == NULL || (block->refs > 1 && !block->mapped)){
+        // allocates block
+        block = BlockAlloc(node->pid, node->page);
+        // out of swap if no more memory
+        if(block == NULL){
+            return P3_OUT_OF_SWAP;
+        }
+    }
+    EntrySetBlock(entry, block);
+    // write page to disk, the frame can't be reused until it's done
+    block->writes++;
+    IOSubmit(SWAP_WRITE, block->unit, block->sector, node, 0, FALSE);
+    P3_TP(P3_TP_SWAP_WRITE, node->pid, node->page, node->frame, units[block->unit].unit,
+        block->sector);
+    P3_vmStats.pageOuts++;
+    if(node->pid != -1){
+        P3_procStats[node->pid].pageOuts++;
+    }
+    return P1_SUCCESS;
+}
+
+// TRUE if no unit has a request queued or in transfer, called with io_lock held
+static int
+IOIdle(void)
+{
+    int i;
+
+    for(i = 0; i < numIOUnits; i++){
+        if(units[i].queue != NULL || units[i].active != NULL){
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+// TRUE if a request on the block is queued or in transfer, called with io_lock held
+static int
+IOBlockBusy(swap_space *block)
+{
+    swap_request *cur;
+
+    for(cur = units[block->unit].queue; cur != NULL; cur = cur->next){
+        if(cur->sector == block->sector && (cur->op == SWAP_READ || cur->op == SWAP_WRITE)){
+            return TRUE;
+        }
+    }
+    for(cur = units[block->unit].active; cur != NULL; cur = cur->next){
+        if(cur->sector == block->sector && (cur->op == SWAP_READ || cur->op == SWAP_WRITE)){
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+// orders blocks by the (pid, page) they were allocated for, qsort comparison
+static int
+BlockCompare(const void *a, const void *b)
+{
+    swap_space *x = *(swap_space **) a;
+    swap_space *y = *(swap_space **) b;
+
+    if(x->pid != y->pid){
+        return x->pid - y->pid;
+    }
+    return x->page - y->page;
+}
+
+// fills sorted with the blocks in use on a unit, in (pid, page) order, returns how many
+static int
+UnitBlocks(swap_unit *unit, swap_space **sorted)
+{
+    int count = 0;
+    int i;
+
+    for(i = 0; i < unit->blocks; i++){
+        if(unit->slots[i]->pid != -1){
+            sorted[count++] = unit->slots[i];
+        }
+    }
+    qsort(sorted, count, sizeof(swap_space *), BlockCompare);
+    return count;
+}
+
+/*
+ * Sets P3_vmStats.fragmentation: of the places where a process's next block on a unit
+ * (in page order) could follow the previous one, the percentage where it doesn't. Those
+ * pages can't be read or written in one clustered transfer.
+ */
+static void
+FragmentationUpdate(swap_space **sorted)
+{
+    int pairs = 0, apart = 0;
+    int count, i, k;
+
+    for(i = 0; i < numUnits; i++){
+        count = UnitBlocks(&units[i], sorted);
+        for(k = 1; k < count; k++){
+            if(sorted[k]->pid == sorted[k - 1]->pid){
+                pairs++;
+                if(sorted[k]->sector != sorted[k - 1]->sector + sectorsInBlock){
+                    apart++;
+                }
+            }
+        }
+    }
+    P3_vmStats.fragmentation = pairs > 0 ? apart * 100 / pairs : 0;
+}
+
+/*
+ * Moves the contents of block src to the free block dst and points every swap map entry
+ * that used src at dst. The copy only starts if no unit has a request queued or in
+ * transfer, and io_lock is held until it is done, so nothing can be queued for the disks
+ * meanwhile and the SwapDisk processes wait for it like for any other transfer. The VM
+ * lock is released during the copy so faults aren't held up until they need to queue I/O;
+ * if src was written or freed meanwhile, or a request for it was queued, the move is
+ * abandoned. Returns TRUE if the block was moved. Called with the VM lock held.
+ */
+static int
+BlockMove(swap_space *src, swap_space *dst)
+{
+    swap_entry *entry;
+    int writes = src->writes;
+    int moved;
+    int rc, i, j;
+
+    rc = P1_Lock(io_lock);
+    assert(rc == P1_SUCCESS);
+    if(!IOIdle()){
+        rc = P1_Unlock(io_lock);
+        assert(rc == P1_SUCCESS);
+        return FALSE;
+    }
+    P3_TP(P3_TP_MOVE, src->pid, src->page, src->sector, units[dst->unit].unit, dst->sector);
+    // reserve dst so BlockAlloc doesn't hand it out
+    dst->pid = src->pid;
+    dst->page = src->page;
+    dst->refs = 0;
+    P3_vmStats.freeBlocks--;
+    P3VmUnlock();
+    IOSeek(&units[src->unit], src->sector);
+    rc = P2_DiskRead(units[src->unit].unit, src->sector, sectorsInBlock, compact_buffer);
+    assert(rc == P1_SUCCESS);
+    units[src->unit].head_sector = src->sector + sectorsInBlock;
+    IOSeek(&units[dst->unit], dst->sector);
+    rc = P2_DiskWrite(units[dst->unit].unit, dst->sector, sectorsInBlock, compact_buffer);
+    assert(rc == P1_SUCCESS);
+    units[dst->unit].head_sector = dst->sector + sectorsInBlock;
+    // io_lock goes first, a fault holding the VM lock may be waiting for it in IOSubmit
+    rc = P1_Unlock(io_lock);
+    assert(rc == P1_SUCCESS);
+    P3VmLock();
+    rc = P1_Lock(io_lock);
+    assert(rc == P1_SUCCESS);
+    moved = src->writes == writes && src->refs > 0 && !IOBlockBusy(src);
+    rc = P1_Unlock(io_lock);
+    assert(rc == P1_SUCCESS);
+    if(!moved){
+        dst->pid = -1;
+        dst->page = -1;
+        P3_vmStats.freeBlocks++;
+        return FALSE;
+    }
+    for(i = 0; i < P1_MAXPROC * numPages; i++){
+        if(swap_map[i].block == src){
+            swap_map[i].block = dst;
+        }
+    }
+    for(i = 0; i < P3_MAX_REGIONS; i++){
+        for(j = 0; regions[i].in_use && j < regions[i].pages; j++){
+            entry = &regions[i].entries[j];
+            if(entry->block == src){
+                entry->block = dst;
+            }
+        }
+    }
+    dst->refs = src->refs;
+    src->refs = 0;
+    src->pid = -1;
+    src->page = -1;
+    P3_vmStats.compacted++;
+    return TRUE;
+}
+
+// writes a mapped page back to its block if it was changed since it was read
+static void
+MapWriteBack(swap_entry *entry, memory_node *node)
+{
+    int access_bits, rc;
+
+    if(!EntryMapped(entry)){
+        return;
+    }
+    rc = USLOSS_MmuGetAccess(node->frame, &access_bits);
+    assert(rc == USLOSS_MMU_OK);
+    if(access_bits & USLOSS_MMU_DIRTY){
+        // a mapped page has a block already, saving it can't run out of swap
+        rc = EntrySave(entry, node);
+        assert(rc == P1_SUCCESS);
+        P3_vmStats.mapWrites++;
+        rc = USLOSS_MmuSetAccess(node->frame, access_bits & ~USLOSS_MMU_DIRTY);
+        assert(rc == USLOSS_MMU_OK);
+    }
+}
+
+// takes node off the inactive list, the page stays in the frame
+static void
+InactiveRemove(memory_node *node)
+{
+    if(node->inactive_prev != NULL){
+        node->inactive_prev->inactive_next = node->inactive_next;
+    }
+    else{
+        inactive_head = node->inactive_next;
+    }
+    if(node->inactive_next != NULL){
+        node->inactive_next->inactive_prev = node->inactive_prev;
+    }
+    else{
+        inactive_tail = node->inactive_prev;
+    }
+    SwapEntry(node->pid, node->page)->inactive = NULL;
+    node->inactive = FALSE;
+    BitClear(inactive_map, node->frame);
+    inactive_count--;
+}
+
+/*
+ * Unmaps node's page and puts it at the head of the inactive list, leaving it in the frame.
+ * It is saved first if it is dirty or has never been saved, so its frame can be reclaimed
+ * later without any I/O. access_bits are the frame's.
+ */
+static int
+FrameDeactivate(memory_node *node, int access_bits)
+{
+    swap_entry *entry;
+    int rc;
+
+    entry = SwapEntry(node->pid, node->page);
+    if((access_bits & USLOSS_MMU_DIRTY) || EntryEmpty(entry)){
+        rc = EntrySave(entry, node);
+        if(rc != P1_SUCCESS){
+            return rc;
+        }
+        rc = USLOSS_MmuSetAccess(node->frame, access_bits & ~USLOSS_MMU_DIRTY);
+        assert(rc == USLOSS_MMU_OK);
+    }
+    P3_TP(P3_TP_DEACTIVATE, node->pid, node->page, node->frame, -1, -1);
+    PageUnmap(node->pid, node->page);
+    entry->inactive = node;
+    node->inactive = TRUE;
+    node->inactive_prev = NULL;
+    node->inactive_next = inactive_head;
+    if(inactive_head != NULL){
+        inactive_head->inactive_prev = node;
+    }
+    else{
+        inactive_tail = node;
+    }
+    inactive_head = node;
+    BitSet(inactive_map, node->frame);
+    inactive_count++;
+    return P1_SUCCESS;
+}
+
+// gives up the frame of a page on the inactive list, the page is already saved
+static void
+InactiveReclaim(memory_node *node)
+{
+    int pid = node->pid;
+
+    SwapEntry(pid, node->page)->shadow = ++evictions;
+    InactiveRemove(node);
+    FrameOwnerSet(node, -1);
+    node->page = -1;
+    P3_vmStats.replaced++;
+    P3_procStats[pid].replaced++;
+}
+
+/*
+ * Works out the refault distance of a page coming back into node's frame from entry: how
+ * many pages were evicted between its own eviction and now. If that's no more than the
+ * frames outside the inactive list, the page would have stayed in memory had the inactive
+ * list been that much longer, i.e. it was evicted just before it was needed again, as in a
+ * loop over slightly more pages than there are frames. Such a page is promoted: it starts
+ * out referenced, so the clock passes it over once and evicts a page that has been around
+ * longer instead.
+ */
+static void
+Refault(swap_entry *entry, memory_node *node)
+{
+    unsigned long distance;
+
+    if(entry->shadow == 0){
+        return;
+    }
+    distance = evictions - entry->shadow;
+    entry->shadow = 0;
+    // promoting goes with the inactive list, without it the clock is left as it was
+    if(inactive_target > 0 && distance <= (unsigned long) (numFrames - inactive_target)){
+        P3_vmStats.refaults++;
+        BitSet(ref_shadow, node->frame);
+    }
+}
+
+// frees the frame the entry's page is still in if it is on the inactive list
+static void
+InactiveDrop(swap_entry *entry)
+{
+    memory_node *node = entry->inactive;
+
+    if(node != NULL){
+        InactiveRemove(node);
+        FrameOwnerSet(node, -1);
+        node->page = -1;
+        P3FrameFree(node->frame);
+    }
+}
+
+static void
+RegionFree(shared_region *region)
+{
+    memory_node *node;
+    int i;
+
+    for(i = 0; i < region->pages; i++){
+        if(region->frames[i] != -1){
+            // nobody is attached, so nothing maps the frame any more
+            node = FrameNode(region->frames[i]);
+            MapWriteBack(&region->entries[i], node);
+            node->region = NULL;
+            if(node->pid == -1){
+                P3FrameFree(node->frame);
+            }
+        }
+        EntrySetBlock(&region->entries[i], NULL);
+    }
+    free(region->frames);
+    free(region->entries);
+    memset(region, 0, sizeof(shared_region));
+}
+
+// sets up a unit's queue and forks its SwapDisk process
+static void
+UnitStart(swap_unit *unit)
+{
+    char name[P1_MAXNAME];
+    int rc, pid;
+
+    unit->queue = NULL;
+    unit->active = NULL;
+    unit->head_sector = 0;
+    unit->cluster_buffer = (char *)malloc(P3_MAX_CLUSTER * pageSize);
+    snprintf(name, sizeof(name), "P3SwapIOPending%d", unit->unit);
+    rc = P1_CondCreate(name, io_lock, &unit->pending);
+    assert(rc == P1_SUCCESS);
+    snprintf(name, sizeof(name), "SwapDisk%d", unit->unit);
+    rc = P1_Fork(name, SwapDisk, unit, USLOSS_MIN_STACK * 4, P3_PAGER_PRIORITY, 0, &pid);
+    assert(rc == P1_SUCCESS);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3SwapInit --
+ *
+ *  Initializes the swap data structures.
+ *
+ * Results:
+ *   P3_ALREADY_INITIALIZED:    this function has already been called
+ *   P1_SUCCESS:                success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3SwapInit(int pages, int frames)
+{
+    int result = P1_SUCCESS;
+    int rc;
+    void *vmRegion;
+    void *pmAddr;
+    int mmuPages, mmuFrames, mode, sectorSize, numSectors;
+    int i, j;
+    int blocks[USLOSS_DISK_UNITS];
+    int unit_blocks, block;
+    swap_space *cur_disk, *new_disk;
+    memory_node *cur_mem;
+    // check if initialized
+    if(initialized == 1){
+        return P3_ALREADY_INITIALIZED;
+    }
+    // sets global numFrames
+    numFrames = frames;
+    numPages = pages;
+    // get mmu info
+    rc = USLOSS_MmuGetConfig(&vmRegion, &pmAddr, &pageSize, &mmuPages, &mmuFrames, &mode);
+    assert(rc == USLOSS_MMU_OK);
+    // memory init (will be used)
+    // This is the clock
+    head_memory = (memory_node *)malloc(sizeof(memory_node));
+    head_memory->pid = -1;
+    head_memory->page = -1;
+    head_memory->frame = 0;
+    head_memory->frame_address = pmAddr;
+    head_memory->sharers = NULL;
+    head_memory->region = NULL;
+    head_memory->io = 0;
+    head_memory->filling = FALSE;
+    head_memory->waiters = NULL;
+    head_memory->pins = 0;
+    head_memory->inactive = FALSE;
+    cur_mem = head_memory;
+    // create rest of linked list
+    for(i = 1; i < frames; i++){
+        cur_mem->next = (memory_node *)malloc(sizeof(memory_node));
+        cur_mem = cur_mem->next;
+        cur_mem->pid = -1;
+        cur_mem->page = -1;
+        cur_mem->frame = i;
+        cur_mem->frame_address = pmAddr + (i * pageSize);
+        cur_mem->sharers = NULL;
+        cur_mem->region = NULL;
+        cur_mem->io = 0;
+        cur_mem->filling = FALSE;
+        cur_mem->waiters = NULL;
+        cur_mem->pins = 0;
+        cur_mem->inactive = FALSE;
+    }
+    cur_mem->next = NULL;
+    frame_nodes = (memory_node **)malloc(frames * sizeof(memory_node *));
+    for(cur_mem = head_memory; cur_mem != NULL; cur_mem = cur_mem->next){
+        frame_nodes[cur_mem->frame] = cur_mem;
+    }
+    for(i = 0; i < P1_MAXPROC; i++){
+        resident[i] = 0;
+        frame_limit[i] = 0;
+        local_hand[i] = -1;
+    }
+    clock_hand = -1;
+    map_words = (frames + WORD_BITS - 1) / WORD_BITS;
+    ref_shadow = (unsigned long *)calloc(map_words, sizeof(unsigned long));
+    io_busy = (unsigned long *)calloc(map_words, sizeof(unsigned long));
+    pinned = (unsigned long *)calloc(map_words, sizeof(unsigned long));
+    inactive_map = (unsigned long *)calloc(map_words, sizeof(unsigned long));
+    // every frame starts out free, phase3b says when it hands one out
+    free_map = (unsigned long *)calloc(map_words, sizeof(unsigned long));
+    for(i = 0; i < frames; i++){
+        BitSet(free_map, i);
+    }
+    inactive_head = NULL;
+    inactive_tail = NULL;
+    inactive_count = 0;
+    inactive_target = frames * P3_inactivePercent / 100;
+    if(P3_inactivePercent > 0 && inactive_target < 1){
+        inactive_target = 1;
+    }
+    evictions = 0;
+    for(i = frames; i < map_words * WORD_BITS; i++){
+        BitSet(io_busy, i);
+    }
+
+    //swap space init
+    // the units in P3_swapUnits, each with as many page sized blocks as fit on it
+    numUnits = 0;
+    numBlocks = 0;
+    unit_blocks = 0;
+    for(i = 0; i < USLOSS_DISK_UNITS; i++){
+        if((P3_swapUnits & (1 << i)) == 0){
+            continue;
+        }
+        rc = P2_DiskSize(i, &sectorSize, &numSectors);
+        assert(rc == P1_SUCCESS);
+        // pageSize / sectorSize gives us how many sectors are in a page
+        sectorsInBlock = (pageSize / sectorSize);
+        units[numUnits].unit = i;
+        blocks[numUnits] = numSectors / sectorsInBlock;
+        units[numUnits].blocks = blocks[numUnits];
+        units[numUnits].slots = (swap_space **)malloc(blocks[numUnits] * sizeof(swap_space *));
+        numBlocks += blocks[numUnits];
+        if(blocks[numUnits] > unit_blocks){
+            unit_blocks = blocks[numUnits];
+        }
+        numUnits++;
+    }
+    assert(numUnits > 0);
+    // stripe the blocks across the units, BlockAlloc takes the first free block so pages
+    // swapped out one after another go to different units. A unit that is smaller than the
+    // others just drops out of the rotation when it is full.
+    head_disk = NULL;
+    cur_disk = NULL;
+    block = 0;
+    for(i = 0; i < unit_blocks; i++){
+        for(j = 0; j < numUnits; j++){
+            if(i >= blocks[j]){
+                continue;
+            }
+            new_disk = (swap_space *)malloc(sizeof(swap_space));
+            new_disk->pid = -1;
+            new_disk->page = -1;
+            new_disk->block = block++;
+            new_disk->unit = j;
+            new_disk->sector = i * sectorsInBlock;
+            new_disk->refs = 0;
+            new_disk->writes = 0;
+            new_disk->mapped = FALSE;
+            new_disk->next = NULL;
+            units[j].slots[i] = new_disk;
+            if(cur_disk == NULL){
+                head_disk = new_disk;
+            }
+            else{
+                cur_disk->next = new_disk;
+            }
+            cur_disk = new_disk;
+        }
+    }
+    // swap map, nothing is in swap yet
+    swap_map = (swap_entry *)calloc(P1_MAXPROC * pages, sizeof(swap_entry));
+    P3_vmStats.blocks = numBlocks;
+    P3_vmStats.freeBlocks = numBlocks;
+    // swap unit queues
+    io_shutdown = FALSE;
+    io_seq = 0;
+    compact_buffer = (char *)malloc(pageSize);
+    rc = P1_LockCreate("P3SwapIOLock", &io_lock);
+    assert(rc == P1_SUCCESS);
+    for(i = 0; i < numUnits; i++){
+        UnitStart(&units[i]);
+    }
+    numIOUnits = numUnits;
+    initialized = 1;
+    return result;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3SwapShutdown --
+ *
+ *  Tells the SwapDisk processes to quit once their queues are empty.
+ *
+ *----------------------------------------------------------------------
+ */
+void
+P3SwapShutdown(void)
+{
+    int rc, i;
+
+    if(initialized == 0){
+        return;
+    }
+    rc = P1_Lock(io_lock);
+    assert(rc == P1_SUCCESS);
+    io_shutdown = TRUE;
+    for(i = 0; i < numIOUnits; i++){
+        rc = P1_Signal(units[i].pending);
+        assert(rc == P1_SUCCESS);
+    }
+    rc = P1_Unlock(io_lock);
+    assert(rc == P1_SUCCESS);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3SwapFreeAll --
+ *
+ *  Frees all swap space used by a process
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:    P3SwapInit has not been called
+ *   P1_INVALID_PID:        pid is invalid
+ *   P1_SUCCESS:            success
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+P3SwapFreeAll(int pid)
+{
+    int result = P1_SUCCESS;
+    int page;
+    int i;
+    // free all swap space used by the process
+    if(initialized == 0){
+        return P3_NOT_INITIALIZED;
+    }
+    if(pid < 0 || pid >= P1_MAXPROC){
+        return P1_INVALID_PID;
+    }
+    // blocks can be shared with merged pages of other processes, so drop this process's
+    // references rather than freeing every block it owns
+    for(page = 0; page < numPages; page++){
+        InactiveDrop(SwapEntry(pid, page));
+        EntrySetBlock(SwapEntry(pid, page), NULL);
+        memset(SwapEntry(pid, page), 0, sizeof(swap_entry));
+    }
+    // detach from shared regions, the last process out frees the region
+    for(i = 0; i < P3_MAX_REGIONS; i++){
+        if(regions[i].in_use && regions[i].attached[pid]){
+            regions[i].attached[pid] = FALSE;
+            regions[i].refs--;
+            if(regions[i].refs == 0){
+                RegionFree(&regions[i]);
+            }
+        }
+    }
+
+    return result;
+}
+
+/*
+ * Moves the reference bits the MMU has set into ref_shadow and clears them in the MMU, so
+ * the references made after this show up next time. Only the frames that were referenced
+ * are written back to the MMU.
+ */
+static void
+AccessHarvest(void)
+{
+    int access_bits, rc, frame;
+
+    for(frame = 0; frame < numFrames; frame++){
+        rc = USLOSS_MmuGetAccess(frame, &access_bits);
+        assert(rc == USLOSS_MMU_OK);
+        if(access_bits & USLOSS_MMU_REF){
+            rc = USLOSS_MmuSetAccess(frame, access_bits & ~USLOSS_MMU_REF);
+            assert(rc == USLOSS_MMU_OK);
+            BitSet(ref_shadow, frame);
+        }
+    }
+}
+
+/*
+ * Advances the clock from frame start to the first frame that is not referenced, busy,
+ * pinned, inactive or free, clearing the reference bits of the frames it passes like the
+ * hand does. Returns the frame, or -1 if it got to the end of the frames without finding one.
+ */
+static int
+ClockScan(int start)
+{
+    unsigned long mask = ~0UL << (start % WORD_BITS);
+    unsigned long candidates, passed, skipped;
+    int word, bit;
+
+    for(word = start / WORD_BITS; word < map_words; word++, mask = ~0UL){
+        skipped = io_busy[word] | pinned[word] | inactive_map[word] | free_map[word];
+        candidates = ~(ref_shadow[word] | skipped) & mask;
+        if(candidates != 0){
+            bit = __builtin_ctzl(candidates);
+            passed = mask & ((1UL << bit) - 1);
+            ref_shadow[word] &= ~(passed & ~skipped);
+            return word * WORD_BITS + bit;
+        }
+        // skipped frames keep their reference bits, the hand didn't really look at them
+        ref_shadow[word] &= ~(mask & ~skipped);
+    }
+    return -1;
+}
+
+/*
+ * Picks one of pid's own frames to replace, for a process at its frame limit. Works like
+ * the clock but only looks at the frames pid owns, with a hand of its own, so the other
+ * processes' reference bits are left alone. The access bits of the frame are returned in
+ * *access_bits. Frames on the inactive list are skipped like the clock skips them. Returns
+ * P3_FRAMES_BUSY if all of pid's other frames have I/O outstanding, or P3_PAGE_NOT_FOUND if
+ * they are all pinned or inactive so pid has nothing it can replace.
+ */
+static int
+LocalVictim(int pid, int *frame, int *access_bits)
+{
+    memory_node *node;
+    int i, rc, hand;
+    int found = FALSE;
+
+    for(i = 1; i <= 2 * numFrames; i++){
+        hand = (local_hand[pid] + i) % numFrames;
+        node = FrameNode(hand);
+        if(node->pid != pid || node->pins > 0 || node->inactive){
+            continue;
+        }
+        found = TRUE;
+        if(node->io > 0){
+            continue;
+        }
+        rc = USLOSS_MmuGetAccess(hand, access_bits);
+        assert(rc == USLOSS_MMU_OK);
+        if((*access_bits & USLOSS_MMU_REF) == 0 && !BitTest(ref_shadow, hand)){
+            local_hand[pid] = hand;
+            *frame = hand;
+            return P1_SUCCESS;
+        }
+        BitClear(ref_shadow, hand);
+        if(*access_bits & USLOSS_MMU_REF){
+            rc = USLOSS_MmuSetAccess(hand, *access_bits & ~USLOSS_MMU_REF);
+            assert(rc == USLOSS_MMU_OK);
+        }
+    }
+    return found ? P3_FRAMES_BUSY : P3_PAGE_NOT_FOUND;
+}
+
+/*
+ * Runs the clock to pick a frame whose page hasn't been referenced lately, returning it in
+ * *frame and its access bits in *access_bits. Returns P3_FRAMES_BUSY if there isn't a
+ * frame it can take.
+ */
+static int
+ClockVictim(int *frame, int *access_bits)
+{
+    int turns;
+    int rc;
+
+    // checks for frame to overwrite, skipping frames with I/O outstanding; after three
+    // trips around the clock every frame is busy and the fault has to wait for one to finish
+    turns = 0;
+    while(1){
+        clock_hand = ClockScan(clock_hand + 1);
+        if(clock_hand == -1){
+            if(++turns == 3){
+                return P3_FRAMES_BUSY;
+            }
+            AccessHarvest();
+            continue;
+        }
+        rc = USLOSS_MmuGetAccess(clock_hand, access_bits);
+        assert(rc == USLOSS_MMU_OK);
+        // if refererence bit is not set
+        if((*access_bits & USLOSS_MMU_REF) == 0){
+            break;
+        }
+        // referenced since the last harvest, set it to 0
+        else{
+            rc = USLOSS_MmuSetAccess(clock_hand, *access_bits & ~USLOSS_MMU_REF);
+            assert(rc == USLOSS_MMU_OK);
+        }
+    }
+    *frame = clock_hand;
+    return P1_SUCCESS;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3AccessHarvest --
+ *
+ *  Collects the reference bits of all the frames for the clock in
+ *  P3SwapOut, ahead of the next fault that needs a frame.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:    P3SwapInit has not been called
+ *   P1_SUCCESS:            success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3AccessHarvest(void)
+{
+    if(initialized == 0){
+        return P3_NOT_INITIALIZED;
+    }
+    AccessHarvest();
+    return P1_SUCCESS;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3SwapOut --
+ *
+ * Uses the clock algorithm to select a frame to replace, writing the page that is in the frame out
+ * to swap if it is dirty. The page table of the page’s process is modified so that the page no
+ * longer maps to the frame. The frame that was selected is returned in *frame.
+ *
+ * A page whose words are all the same is not written to disk; the swap map records the
+ * fill value instead and any block the page had is released.
+ *
+ * The clock works from ref_shadow rather than asking the MMU about each frame. The MMU's
+ * reference bits are harvested into it each time the hand goes around, and the frame the
+ * hand stops at is checked once more in case it was referenced since.
+ *
+ * If fault_pid, the process the frame is for, is at its frame limit (P3FrameLimitSet), the
+ * frame is one of its own instead (LocalVictim). If it has none it can replace, because
+ * they are all pinned, P3_PAGE_NOT_FOUND is returned and it is up to the caller whether it
+ * goes over its limit; fault_pid -1 picks from all the frames. Frames with pinned pages are
+ * never picked.
+ *
+ * The pages the clock picks go onto the inactive list until it holds P3_inactivePercent of
+ * the frames, if that isn't 0: they are saved and unmapped but stay in their frames, and the frame returned
+ * is the one at the tail of the list. A fault on an inactive page maps it back without any
+ * I/O (P3InactiveGet). Pages in a shared region or a merged frame are replaced right away.
+ * Pages that come back soon after they were evicted are promoted (Refault).
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:    P3SwapInit has not been called
+ *   P1_OUT_OF_SWAP:        there is no more swap space
+ *   P3_FRAMES_BUSY:        every frame has I/O outstanding
+ *   P3_PAGE_NOT_FOUND:     fault_pid is at its frame limit and all of its
+ *                          frames are pinned
+ *   P1_SUCCESS:            success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3SwapOut(PID fault_pid, int *frame)
+{
+    /*****************
+
+    static int hand = -1;    // initially start with frame 0
+    if not initialized
+        return P3_NOT_INITIALIZED
+    loop
+        hand = (hand + 1) % numFrames
+        get access bits for the frame indicated by hand (USLOSS_MmuGetAccess)
+        if reference bit is not set in the access bits
+            frame = hand
+            break
+        else
+            clear frame's reference bit (USLOSS_MmuSetAccess)
+    page = page that's in the selected frame
+    pid = pid of the page
+    if dirty bit is set in the access bits or page isn't in swap space
+        if page is filled with a single value
+            record the value in the swap map, free the page's swap space
+        else
+            if page doesn't already have swap space
+                if there is free swap space
+                    allocate swap space for the page
+                else
+                    return P3_OUT_OF_SWAP
+            write page to its swap space (P2_DiskWrite)
+        clear frame's dirty bit (USLOSS_MmuSetAccess)
+    get page table for pid (P3PageTableGet)
+    update page's PTE to indicate page is no longer in the frame
+
+    *****************/
+    int access_bits, rc, page, pid;
+    int victim;
+    int limited;
+    int need_write;
+    memory_node *cur_mem;
+    frame_map *map;
+    swap_entry *entry;
+    // error check
+    if(initialized == 0){
+        return P3_NOT_INITIALIZED;
+    }
+    *frame = -1;
+    rc = P3FrameLimitReached(fault_pid, &limited);
+    if(rc == P1_SUCCESS && limited){
+        rc = LocalVictim(fault_pid, frame, &access_bits);
+        if(rc != P1_SUCCESS){
+            return rc;
+        }
+    }
+    // the inactive list is topped up from the clock, one past its target since the frame
+    // comes off its tail; a page that can't be kept on the list is replaced right away instead
+    while(*frame == -1 && inactive_target > 0 && inactive_count <= inactive_target){
+        rc = ClockVictim(&victim, &access_bits);
+        if(rc != P1_SUCCESS){
+            break;
+        }
+        cur_mem = FrameNode(victim);
+        if(cur_mem->pid == -1 || cur_mem->region != NULL || cur_mem->sharers != NULL){
+            *frame = victim;
+            break;
+        }
+        rc = FrameDeactivate(cur_mem, access_bits);
+        if(rc != P1_SUCCESS){
+            // out of swap, but a page that's already saved can still give up its frame
+            if(inactive_tail == NULL){
+                return rc;
+            }
+            break;
+        }
+    }
+    if(*frame == -1 && inactive_target == 0){
+        rc = ClockVictim(frame, &access_bits);
+        if(rc != P1_SUCCESS){
+            return rc;
+        }
+    }
+    if(*frame == -1){
+        if(inactive_tail == NULL){
+            return P3_FRAMES_BUSY;
+        }
+        *frame = inactive_tail->frame;
+    }
+    cur_mem = FrameNode(*frame);
+    if(cur_mem->inactive){
+        P3_TP(P3_TP_VICTIM, cur_mem->pid, cur_mem->page, *frame, -1, -1);
+        InactiveReclaim(cur_mem);
+        return P1_SUCCESS;
+    }
+    // set page and pid (stored in frame being swapped)
+    page = cur_mem->page;
+    pid = cur_mem->pid;
+    P3_TP(P3_TP_VICTIM, pid, page, *frame, -1, -1);
+    // the clock skips free frames, so the frame is holding a page
+    assert(pid != -1 || cur_mem->region != NULL);
+    entry = FrameEntry(cur_mem);
+    // if dirty bit is set or any page in the frame has never been saved
+    need_write = (access_bits & USLOSS_MMU_DIRTY) || EntryEmpty(entry);
+    if(cur_mem->region == NULL){
+        for(map = cur_mem->sharers; map != NULL; map = map->next){
+            need_write = need_write || EntryEmpty(SwapEntry(map->pid, map->page));
+        }
+    }
+    if(need_write){
+        rc = EntrySave(entry, cur_mem);
+        if(rc != P1_SUCCESS){
+            return rc;
+        }
+        // a merged frame is written once and every page in it points at the same copy;
+        // pages attached to a shared region all use the region's entry already
+        if(cur_mem->region == NULL){
+            for(map = cur_mem->sharers; map != NULL; map = map->next){
+                if(entry->filled){
+                    EntrySetFill(SwapEntry(map->pid, map->page), entry->fill);
+                }
+                else{
+                    EntrySetBlock(SwapEntry(map->pid, map->page), entry->block);
+                }
+            }
+        }
+        // frame is no longer dirty since written to disk, so set dirty bit to 0
+        rc = USLOSS_MmuSetAccess(*frame, access_bits & ~USLOSS_MMU_DIRTY);
+        assert(rc == USLOSS_MMU_OK);
+    }
+    if(cur_mem->region != NULL){
+        cur_mem->region->frames[cur_mem->region_page] = -1;
+        cur_mem->region = NULL;
+    }
+    // modify page tables for every page in the frame
+    if(pid != -1){
+        PageUnmap(pid, page);
+    }
+    while(cur_mem->sharers != NULL){
+        map = cur_mem->sharers;
+        PageUnmap(map->pid, map->page);
+        cur_mem->sharers = map->next;
+        free(map);
+    }
+    FrameOwnerSet(cur_mem, -1);
+    cur_mem->page = -1;
+    entry->shadow = ++evictions;
+    P3_vmStats.replaced++;
+    if(pid != -1){
+        P3_procStats[pid].replaced++;
+    }
+    return P1_SUCCESS;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3InactiveGet --
+ *
+ *  If pid's page is on the inactive list, takes it off and returns the
+ *  frame it is still in in *frame, so the fault on it is resolved by
+ *  just mapping it back.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:     P3SwapInit has not been called
+ *   P1_INVALID_PID:         pid is invalid
+ *   P3_INVALID_PAGE:        page is invalid
+ *   P3_PAGE_NOT_FOUND:      the page is not on the inactive list
+ *   P1_SUCCESS:             success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3InactiveGet(int pid, int page, int *frame)
+{
+    memory_node *node;
+
+    if(initialized == 0){
+        return P3_NOT_INITIALIZED;
+    }
+    if(pid < 0 || pid >= P1_MAXPROC){
+        return P1_INVALID_PID;
+    }
+    if(page < 0 || page >= numPages){
+        return P3_INVALID_PAGE;
+    }
+    node = SwapEntry(pid, page)->inactive;
+    if(node == NULL){
+        return P3_PAGE_NOT_FOUND;
+    }
+    InactiveRemove(node);
+    P3_TP(P3_TP_SOFT_FAULT, pid, page, node->frame, -1, -1);
+    *frame = node->frame;
+    return P1_SUCCESS;
+}
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3SwapIn --
+ *
+ *  Reads a page into a frame from swap. A page that was stored as a fill value is
+ *  rebuilt in the frame without any disk I/O. Reads are queued for the SwapDisk
+ *  process, which finishes the fault (P3PageFaultDone) when the read is done.
+ *  A page that was evicted just before it was needed again is promoted (Refault).
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:     P3SwapInit has not been called
+ *   P1_INVALID_PID:         pid is invalid
+ *   P1_INVALID_PAGE:        page is invalid
+ *   P1_INVALID_FRAME:       frame is invalid
+ *   P3_PAGE_NOT_FOUND:      page is not in swap
+ *   P3_IO_PENDING:          the page is being read in
+ *   P1_SUCCESS:             success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3SwapIn(int pid, int page, int frame)
+{
+    memory_node *cur;
+    swap_entry *entry;
+    /*****************
+
+    if not initialized
+        return P3_NOT_INITIALIZED
+    record that frame holds pid,page for use in P3SwapOut
+    if page is a fill value in the swap map
+        fill the frame with the value
+        return P1_SUCCESS
+    if page is on swap disk
+        queue a read of the page from swap disk into frame
+        return P3_IO_PENDING
+    else
+        return P3_PAGE_NOT_FOUND
+
+    *****************/
+    if(initialized == 0){
+        return P3_NOT_INITIALIZED;
+    }
+    if(pid < 0 || pid >= P1_MAXPROC){
+        return P1_INVALID_PID;
+    }
+    if(page < 0 || page >= numPages){
+        return P3_INVALID_PAGE;
+    }
+    if(frame < 0 || frame >= numFrames){
+        return P3_INVALID_FRAME;
+    }
+    // moves to the specified frame
+    cur = FrameNode(frame);
+    // sets the page and pid of the frame
+    cur->page = page;
+    FrameOwnerSet(cur, pid);
+    // the reference bit is left from the page that was in the frame before, Refault may
+    // set it again for this one
+    BitClear(ref_shadow, frame);
+    entry = SwapEntry(pid, page);
+    // a page in a shared region is read from the region's entry
+    if(entry->region != NULL){
+        cur->region = entry->region;
+        cur->region_page = entry->region_page;
+        entry->region->frames[entry->region_page] = frame;
+        entry = &entry->region->entries[entry->region_page];
+    }
+    Refault(entry, cur);
+    // page was uniform when it was swapped out, rebuild it without touching the disk
+    if(entry->filled){
+        return FrameFill(cur, entry->fill);
+    }
+    // if page is in disk queue a read of the page into the frame, the fault is finished
+    // when it's done
+    if(entry->block != NULL){
+        IOSubmit(SWAP_READ, entry->block->unit, entry->block->sector, cur, 0, TRUE);
+        P3_TP(P3_TP_SWAP_READ, pid, page, frame, units[entry->block->unit].unit,
+            entry->block->sector);
+        P3_vmStats.pageIns++;
+        P3_procStats[pid].pageIns++;
+        return P3_IO_PENDING;
+    }
+    else{
+        return P3_PAGE_NOT_FOUND;
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3FrameMap --
+ *
+ *  Records that a frame holds pid's page. Used when a page is put in a
+ *  frame without P3SwapIn, e.g. a copy made on a copy-on-write fault.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:     P3SwapInit has not been called
+ *   P1_INVALID_PID:         pid is invalid
+ *   P3_INVALID_PAGE:        page is invalid
+ *   P3_INVALID_FRAME:       frame is invalid
+ *   P1_SUCCESS:             success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3FrameMap(int pid, int page, int frame)
+{
+    memory_node *cur;
+
+    if(initialized == 0){
+        return P3_NOT_INITIALIZED;
+    }
+    if(pid < 0 || pid >= P1_MAXPROC){
+        return P1_INVALID_PID;
+    }
+    if(page < 0 || page >= numPages){
+        return P3_INVALID_PAGE;
+    }
+    if(frame < 0 || frame >= numFrames){
+        return P3_INVALID_FRAME;
+    }
+    cur = FrameNode(frame);
+    assert(cur->pid == -1);
+    FrameOwnerSet(cur, pid);
+    cur->page = page;
+    BitClear(ref_shadow, frame);
+    // the page is in memory again, a shadow from before doesn't count
+    SwapEntry(pid, page)->shadow = 0;
+    return P1_SUCCESS;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3FrameUnmap --
+ *
+ *  Removes pid's page from a frame's reverse mappings. *mapped is set to
+ *  the number of pages still in the frame; when it is 0 the frame can be
+ *  freed.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:     P3SwapInit has not been called
+ *   P3_INVALID_FRAME:       frame is invalid
+ *   P3_FRAME_NOT_MAPPED:    the page is not in the frame
+ *   P1_SUCCESS:             success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3FrameUnmap(int pid, int page, int frame, int *mapped)
+{
+    memory_node *cur;
+    frame_map **prev;
+    frame_map *map;
+    int count = 0;
+
+    if(initialized == 0){
+        return P3_NOT_INITIALIZED;
+    }
+    if(frame < 0 || frame >= numFrames){
+        return P3_INVALID_FRAME;
+    }
+    cur = FrameNode(frame);
+    if(cur->pid == pid && cur->page == page){
+        // the first sharer takes over the frame
+        map = cur->sharers;
+        if(map != NULL){
+            FrameOwnerSet(cur, map->pid);
+            cur->page = map->page;
+            cur->sharers = map->next;
+            free(map);
+        }
+        else{
+            FrameOwnerSet(cur, -1);
+            cur->page = -1;
+        }
+    }
+    else{
+        for(prev = &cur->sharers; *prev != NULL; prev = &(*prev)->next){
+            if((*prev)->pid == pid && (*prev)->page == page){
+                break;
+            }
+        }
+        if(*prev == NULL){
+            return P3_FRAME_NOT_MAPPED;
+        }
+        map = *prev;
+        *prev = map->next;
+        free(map);
+    }
+    if(cur->pid != -1){
+        count = 1;
+        for(map = cur->sharers; map != NULL; map = map->next){
+            count++;
+        }
+    }
+    // a shared region page stays in its frame for the rest of the region, P3SwapOut or
+    // the region going away frees it
+    if(cur->region != NULL && count == 0){
+        count = 1;
+    }
+    *mapped = count;
+    return P1_SUCCESS;
+}
+
+// TRUE if node's page can be merged with another: shared region pages are already shared
+// and must stay writable, and a mapped page has to be written back to its own block
+static int
+DedupCandidate(memory_node *node)
+{
+    return node->pid != -1 && node->region == NULL && node->io == 0 && node->pins == 0
+        && !node->inactive && !EntryMapped(FrameEntry(node));
+}
+
+// orders frames by contents hash, then by frame, qsort comparison
+static int
+NodeHashCompare(const void *a, const void *b)
+{
+    memory_node *x = *(memory_node **) a;
+    memory_node *y = *(memory_node **) b;
+
+    if(x->hash != y->hash){
+        return x->hash < y->hash ? -1 : 1;
+    }
+    return x->frame - y->frame;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3DedupScan --
+ *
+ *  Merges frames with identical contents. Every frame holding a page that
+ *  can be merged is hashed, and the frames are sorted by hash so only
+ *  frames with equal hashes are compared, in full. The pages in the later
+ *  frame are moved into the earlier one, read-only, so the first write to
+ *  any of them is a copy-on-write fault. The emptied frame goes back to
+ *  the free frame pool.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:     P3SwapInit has not been called
+ *   P1_SUCCESS:             success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3DedupScan(void)
+{
+    memory_node **sorted;
+    memory_node *keep, *dup;
+    frame_map *map, *tail;
+    int count = 0;
+    int rc, access_bits, i, j, k, d;
+
+    if(initialized == 0){
+        return P3_NOT_INITIALIZED;
+    }
+    sorted = (memory_node **)malloc(numFrames * sizeof(memory_node *));
+    for(keep = head_memory; keep != NULL; keep = keep->next){
+        if(DedupCandidate(keep)){
+            keep->hash = PageHash(keep->frame_address);
+            sorted[count++] = keep;
+        }
+    }
+    qsort(sorted, count, sizeof(memory_node *), NodeHashCompare);
+    // i is the first frame with its hash, k the first with the next one
+    for(i = 0; i < count; i = k){
+        for(k = i + 1; k < count && sorted[k]->hash == sorted[i]->hash; k++){
+        }
+        for(j = i; j < k; j++){
+            keep = sorted[j];
+            // it may have been merged into an earlier frame already
+            if(!DedupCandidate(keep)){
+                continue;
+            }
+            for(d = j + 1; d < k; d++){
+                dup = sorted[d];
+                if(!DedupCandidate(dup)){
+                    continue;
+                }
+                // write-protect both before comparing, a write that sneaks in faults to the
+                // pager and waits until the merge is finished
+                FrameProtect(keep, keep->frame, 0);
+                FrameProtect(dup, dup->frame, 0);
+                if(memcmp(keep->frame_address, dup->frame_address, pageSize) != 0){
+                    // pages that aren't shared are normally writable
+                    if(keep->sharers == NULL){
+                        FrameProtect(keep, keep->frame, 1);
+                    }
+                    if(dup->sharers == NULL){
+                        FrameProtect(dup, dup->frame, 1);
+                    }
+                    continue;
+                }
+                P3_TP(P3_TP_MERGE, dup->pid, dup->page, dup->frame, -1, keep->frame);
+                // move dup's pages into keep, the PTEs still have write turned off
+                FrameProtect(dup, keep->frame, 0);
+                map = (frame_map *)malloc(sizeof(frame_map));
+                map->pid = dup->pid;
+                map->page = dup->page;
+                map->next = dup->sharers;
+                tail = map;
+                while(tail->next != NULL){
+                    tail = tail->next;
+                }
+                tail->next = keep->sharers;
+                keep->sharers = map;
+                dup->sharers = NULL;
+                FrameOwnerSet(dup, -1);
+                dup->page = -1;
+                // keep's copy in swap may be older than dup's contents
+                rc = USLOSS_MmuGetAccess(dup->frame, &access_bits);
+                assert(rc == USLOSS_MMU_OK);
+                if(access_bits & USLOSS_MMU_DIRTY){
+                    int keep_bits;
+                    rc = USLOSS_MmuGetAccess(keep->frame, &keep_bits);
+                    assert(rc == USLOSS_MMU_OK);
+                    rc = USLOSS_MmuSetAccess(keep->frame, keep_bits | USLOSS_MMU_DIRTY);
+                    assert(rc == USLOSS_MMU_OK);
+                }
+                rc = USLOSS_MmuSetAccess(dup->frame, 0);
+                assert(rc == USLOSS_MMU_OK);
+                BitClear(ref_shadow, dup->frame);
+                P3FrameFree(dup->frame);
+                P3_vmStats.merged++;
+            }
+        }
+    }
+    free(sorted);
+    return P1_SUCCESS;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3SharedFrameGet --
+ *
+ *  If pid's page is attached to a shared region and the region's page is
+ *  already in a frame, maps the page to that frame and returns it in
+ *  *frame.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:     P3SwapInit has not been called
+ *   P3_PAGE_NOT_FOUND:      the page is not a shared page in memory
+ *   P3_IO_PENDING:          the page is still being read in
+ *   P1_SUCCESS:             success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3SharedFrameGet(int pid, int page, int *frame)
+{
+    swap_entry *entry;
+    memory_node *cur;
+    frame_map *map;
+
+    if(initialized == 0){
+        return P3_NOT_INITIALIZED;
+    }
+    entry = SwapEntry(pid, page);
+    if(entry->region == NULL || entry->region->frames[entry->region_page] == -1){
+        return P3_PAGE_NOT_FOUND;
+    }
+    *frame = entry->region->frames[entry->region_page];
+    cur = FrameNode(*frame);
+    if(cur->pid == -1){
+        FrameOwnerSet(cur, pid);
+        cur->page = page;
+    }
+    else{
+        map = (frame_map *)malloc(sizeof(frame_map));
+        map->pid = pid;
+        map->page = page;
+        map->next = cur->sharers;
+        cur->sharers = map;
+    }
+    // another process's fault is still bringing the page in, finish this one with it
+    if(cur->filling){
+        map = (frame_map *)malloc(sizeof(frame_map));
+        map->pid = pid;
+        map->page = page;
+        map->next = cur->waiters;
+        cur->waiters = map;
+        return P3_IO_PENDING;
+    }
+    return P1_SUCCESS;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3ShareCreate --
+ *
+ *  Turns count of pid's pages starting at page into a shared region that
+ *  other processes can attach to. The pages keep their contents. The
+ *  region's handle is returned in *handle.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:     P3SwapInit has not been called
+ *   P3_INVALID_PAGE:        a page is invalid or already in a shared region
+ *   P3_TOO_MANY_REGIONS:    there are no free regions
+ *   P3_OUT_OF_SWAP:         there is no more swap space
+ *   P1_SUCCESS:             success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3ShareCreate(int pid, int page, int count, int *handle)
+{
+    shared_region *region = NULL;
+    USLOSS_PTE *table;
+    memory_node *node;
+    swap_entry *entry;
+    int mapped;
+    int rc, i;
+
+    if(initialized == 0){
+        return P3_NOT_INITIALIZED;
+    }
+    if(count <= 0 || page < 0 || page + count > numPages){
+        return P3_INVALID_PAGE;
+    }
+    for(i = 0; i < count; i++){
+        if(SwapEntry(pid, page + i)->region != NULL){
+            return P3_INVALID_PAGE;
+        }
+    }
+    for(i = 0; i < P3_MAX_REGIONS; i++){
+        if(!regions[i].in_use){
+            region = &regions[i];
+            *handle = i;
+            break;
+        }
+    }
+    if(region == NULL){
+        return P3_TOO_MANY_REGIONS;
+    }
+    rc = P3PageTableGet(pid, &table);
+    assert(rc == P1_SUCCESS);
+    // a page merged with other pages has to leave the merged frame first
+    for(i = 0; i < count; i++){
+        if(!table[page + i].incore){
+            continue;
+        }
+        node = FrameNode(table[page + i].frame);
+        if(node->sharers != NULL){
+            rc = EntrySave(SwapEntry(pid, page + i), node);
+            if(rc != P1_SUCCESS){
+                return rc;
+            }
+            rc = P3FrameUnmap(pid, page + i, node->frame, &mapped);
+            assert(rc == P1_SUCCESS);
+            table[page + i].incore = 0;
+        }
+    }
+    region->in_use = TRUE;
+    region->pages = count;
+    region->refs = 1;
+    region->attached[pid] = TRUE;
+    region->frames = (int *)malloc(count * sizeof(int));
+    region->entries = (swap_entry *)calloc(count, sizeof(swap_entry));
+    for(i = 0; i < count; i++){
+        // the region takes over the page's swap space
+        entry = SwapEntry(pid, page + i);
+        // an inactive page is already saved, the region reads it back in from there
+        InactiveDrop(entry);
+        region->entries[i] = *entry;
+        memset(entry, 0, sizeof(swap_entry));
+        entry->region = region;
+        entry->region_page = i;
+        region->frames[i] = -1;
+        if(table[page + i].incore){
+            node = FrameNode(table[page + i].frame);
+            node->region = region;
+            node->region_page = i;
+            region->frames[i] = node->frame;
+        }
+    }
+    return P1_SUCCESS;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3ShareAttach --
+ *
+ *  Maps a shared region into pid's pages starting at page. Whatever was
+ *  in those pages is discarded.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:     P3SwapInit has not been called
+ *   P3_INVALID_REGION:      handle is not a shared region
+ *   P3_INVALID_PAGE:        the region doesn't fit, or a page is already
+ *                           in a shared region
+ *   P1_SUCCESS:             success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3ShareAttach(int handle, int pid, int page)
+{
+    shared_region *region;
+    USLOSS_PTE *table;
+    swap_entry *entry;
+    int mapped;
+    int rc, i;
+
+    if(initialized == 0){
+        return P3_NOT_INITIALIZED;
+    }
+    if(handle < 0 || handle >= P3_MAX_REGIONS || !regions[handle].in_use){
+        return P3_INVALID_REGION;
+    }
+    region = &regions[handle];
+    if(page < 0 || page + region->pages > numPages){
+        return P3_INVALID_PAGE;
+    }
+    for(i = 0; i < region->pages; i++){
+        if(SwapEntry(pid, page + i)->region != NULL){
+            return P3_INVALID_PAGE;
+        }
+    }
+    rc = P3PageTableGet(pid, &table);
+    assert(rc == P1_SUCCESS);
+    for(i = 0; i < region->pages; i++){
+        if(table[page + i].incore){
+            rc = P3FrameUnmap(pid, page + i, table[page + i].frame, &mapped);
+            assert(rc == P1_SUCCESS);
+            if(mapped == 0){
+                P3FrameFree(table[page + i].frame);
+            }
+            table[page + i].incore = 0;
+        }
+        entry = SwapEntry(pid, page + i);
+        InactiveDrop(entry);
+        EntrySetBlock(entry, NULL);
+        memset(entry, 0, sizeof(swap_entry));
+        entry->region = region;
+        entry->region_page = i;
+    }
+    if(!region->attached[pid]){
+        region->attached[pid] = TRUE;
+        region->refs++;
+    }
+    return P1_SUCCESS;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3FrameZero --
+ *
+ *  Fills a frame with zeros for a new page. If the frame is still being
+ *  written out the zeroing is queued behind the write.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:     P3SwapInit has not been called
+ *   P3_INVALID_FRAME:       frame is invalid
+ *   P3_IO_PENDING:          the zeroing was queued
+ *   P1_SUCCESS:             success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3FrameZero(int frame)
+{
+    if(initialized == 0){
+        return P3_NOT_INITIALIZED;
+    }
+    if(frame < 0 || frame >= numFrames){
+        return P3_INVALID_FRAME;
+    }
+    return FrameFill(FrameNode(frame), 0);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3FrameCopy --
+ *
+ *  Copies a page into a frame for a fault. If the frame is still being
+ *  written out the copy is queued behind the write. Takes ownership of
+ *  page, which must have been allocated with malloc.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:     P3SwapInit has not been called
+ *   P3_INVALID_FRAME:       frame is invalid
+ *   P3_IO_PENDING:          the copy was queued
+ *   P1_SUCCESS:             success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3FrameCopy(int frame, void *page)
+{
+    memory_node *node;
+    swap_request *request;
+
+    if(initialized == 0){
+        return P3_NOT_INITIALIZED;
+    }
+    if(frame < 0 || frame >= numFrames){
+        return P3_INVALID_FRAME;
+    }
+    node = FrameNode(frame);
+    if(node->io == 0){
+        memcpy(node->frame_address, page, pageSize);
+        free(page);
+        return P1_SUCCESS;
+    }
+    request = IOSubmit(SWAP_COPY, -1, 0, node, 0, TRUE);
+    request->buffer = page;
+    return P3_IO_PENDING;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3SwapCompact --
+ *
+ *  Moves one block toward a compact swap layout, if the swap disks are
+ *  idle. On each unit the blocks in use are packed at the start of the
+ *  unit in (pid, page) order, so each process's pages end up in a run of
+ *  adjacent blocks that can be transferred together. The first block not
+ *  yet in its place is moved there; if the place is taken, the block in
+ *  it is first moved out to a free block past the packed ones, or, if
+ *  there is none, the next block is tried instead. Once a pass is over,
+ *  i.e. nothing was moved, P3_vmStats.fragmentation is updated. Called
+ *  with the VM lock held, which is released while the block is copied.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:     P3SwapInit has not been called
+ *   P1_SUCCESS:             success, *moved is TRUE if a block was moved
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3SwapCompact(int *moved)
+{
+    swap_space **sorted;
+    swap_space *src, *dst;
+    swap_unit *unit;
+    int count, idle;
+    int rc, i, j, k;
+
+    *moved = FALSE;
+    if(initialized == 0){
+        return P3_NOT_INITIALIZED;
+    }
+    sorted = (swap_space **)malloc(numBlocks * sizeof(swap_space *));
+    rc = P1_Lock(io_lock);
+    assert(rc == P1_SUCCESS);
+    idle = IOIdle();
+    rc = P1_Unlock(io_lock);
+    assert(rc == P1_SUCCESS);
+    for(i = 0; idle && i < numUnits && !*moved; i++){
+        unit = &units[i];
+        count = UnitBlocks(unit, sorted);
+        for(k = 0; k < count; k++){
+            if(sorted[k] == unit->slots[k]){
+                continue;
+            }
+            src = sorted[k];
+            dst = unit->slots[k];
+            if(dst->pid != -1){
+                // make room by moving the block in the way past the packed ones
+                src = dst;
+                for(j = count; j < unit->blocks && unit->slots[j]->pid != -1; j++){
+                }
+                if(j == unit->blocks){
+                    continue;
+                }
+                dst = unit->slots[j];
+            }
+            *moved = BlockMove(src, dst);
+            break;
+        }
+    }
+    if(!*moved){
+        FragmentationUpdate(sorted);
+    }
+    free(sorted);
+    return P1_SUCCESS;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3SwapBlock --
+ *
+ *  Returns the swap block pid's page is kept in, -1 if it has none
+ *  (it was never swapped out, or it was stored as a fill value).
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:     P3SwapInit has not been called
+ *   P1_INVALID_PID:         pid is invalid
+ *   P3_INVALID_PAGE:        page is invalid
+ *   P1_SUCCESS:             success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3SwapBlock(PID pid, int page, int *block)
+{
+    swap_entry *entry;
+
+    if(initialized == 0){
+        return P3_NOT_INITIALIZED;
+    }
+    if(pid < 0 || pid >= P1_MAXPROC){
+        return P1_INVALID_PID;
+    }
+    if(page < 0 || page >= numPages){
+        return P3_INVALID_PAGE;
+    }
+    entry = SwapEntry(pid, page);
+    if(entry->region != NULL){
+        entry = &entry->region->entries[entry->region_page];
+    }
+    *block = entry->block != NULL ? entry->block->block : -1;
+    return P1_SUCCESS;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3SwapFind --
+ *
+ *  Sets *found to TRUE if pid's page has been saved to swap, in a block
+ *  or as a fill value, FALSE if it is a new page.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:     P3SwapInit has not been called
+ *   P1_INVALID_PID:         pid is invalid
+ *   P3_INVALID_PAGE:        page is invalid
+ *   P1_SUCCESS:             success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3SwapFind(PID pid, int page, int *found)
+{
+    swap_entry *entry;
+
+    if(initialized == 0){
+        return P3_NOT_INITIALIZED;
+    }
+    if(pid < 0 || pid >= P1_MAXPROC){
+        return P1_INVALID_PID;
+    }
+    if(page < 0 || page >= numPages){
+        return P3_INVALID_PAGE;
+    }
+    entry = SwapEntry(pid, page);
+    if(entry->region != NULL){
+        entry = &entry->region->entries[entry->region_page];
+    }
+    *found = !EntryEmpty(entry);
+    return P1_SUCCESS;
+}
 
-static void debug3(char *fmt, ...)
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3FrameScrub --
+ *
+ *  Zeroes a free frame ahead of the fault that will use it. Unlike
+ *  P3FrameZero nothing is queued if the frame has I/O outstanding.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:     P3SwapInit has not been called
+ *   P3_INVALID_FRAME:       frame is invalid
+ *   P3_FRAMES_BUSY:         the frame has I/O outstanding, it wasn't zeroed
+ *   P1_SUCCESS:             success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3FrameScrub(int frame)
 {
-    va_list ap;
+    memory_node *node;
 
-    if (debugging3) {
-        va_start(ap, fmt);
-        USLOSS_VConsole(fmt, ap);
+    if(initialized == 0){
+        return P3_NOT_INITIALIZED;
     }
+    if(frame < 0 || frame >= numFrames){
+        return P3_INVALID_FRAME;
+    }
+    node = FrameNode(frame);
+    if(node->io > 0){
+        return P3_FRAMES_BUSY;
+    }
+    memset(node->frame_address, 0, pageSize);
+    return P1_SUCCESS;
 }
 
 /*
  *----------------------------------------------------------------------
  *
- * P3SwapInit --
+ * P3FrameLimitSet --
  *
- *  Initializes the swap data structures.
+ *  Limits the number of frames pid may have to limit, 0 for no limit.
+ *  Once pid has limit frames its faults replace its own pages (see
+ *  P3SwapOut). A lower limit than pid has now takes effect as it faults.
  *
  * Results:
- *   P3_ALREADY_INITIALIZED:    this function has already been called
- *   P1_SUCCESS:                success
+ *   P3_NOT_INITIALIZED:     P3SwapInit has not been called
+ *   P1_INVALID_PID:         pid is invalid
+ *   P3_INVALID_NUM_FRAMES:  limit is negative
+ *   P1_SUCCESS:             success
  *
  *----------------------------------------------------------------------
  */
 int
-P3SwapInit(int pages, int frames)
+P3FrameLimitSet(PID pid, int limit)
 {
-    int result = P1_SUCCESS;
-    int rc;
-    void *vmRegion, pmAddr;
-    int pageSize, numPages, numFrames, mode, sectorSize, numSectors;
-    int i;
-    swap_space *cur_disk;
-    memory_node *cur_mem;
-    // check if initialized
-    if(initialized == 1){
-        return P3_ALREADY_INITIALIZED;
+    if(initialized == 0){
+        return P3_NOT_INITIALIZED;
     }
-    // sets global numFrames
-    numFrames = frames;
-    // get mmu info
-    rc = USLOSS_MmuGetConfig(&vmRegion, &pmAddr, &pageSize, &numPages, &numFrames, &mode);
-    assert(rc == USLOSS_MMU_OK);
-    // memory init (will be used)
-    // This is the clock
-    head_memory = (memory_node *)malloc(sizeof(memory_node));
-    head_memory->pid = -1;
-    head_memory->page = -1;
-    head_memory->frame = 0;
-    head_memory->frame_address = pmAddr;
-    cur_mem = head_memory;
-    // create rest of linked list
-    for(i = 1; i < frames; i++){
-        cur_mem->next = (memory_node *)malloc(sizeof(memory_node));
-        cur_mem = cur_mem->next;
-        cur_mem->pid = -1;
-        cur_mem->page = -1;
-        cur_mem->frame = i;
-        cur_mom->frame_address = pmAddr + (i * pageSize)
+    if(pid < 0 || pid >= P1_MAXPROC){
+        return P1_INVALID_PID;
     }
-    cur_mem->next = NULL;
-    
-    //swap space init
-    rc = P2_DiskSize(P3_SWAP_DISK, &sectorSize, &numSectors);
-    assert(rc == P1_SUCCESS);
-    // sets max number of blocks on swap disk
-    // pageSize / sectorSize gives us how many sectors are in a page
-    // numSectors / ^ gives us how many page sized blocks are on the disk
-    // This allows us to keep track of any free blocks in memory
-    numBlocks = numSectors / (pageSize / sectorSize);
-    sectorsInBlock = (pageSize / sectorSize);
-    // set head (will be used)
-    head_disk = (swap_space *)malloc(sizeof(swap_space));
-    head_disk->pid = -1;
-    head_disk->page = -1;
-    head_disk->frame = -1
-    head_disk->block = 0;
-    head_disk->sector = 0;
-    cur_disk = head_disk;
-    // create rest of linked list
-    for(i = 1; i < numBlocks; i++){
-        cur_disk->next = (swap_space *)malloc(sizeof(swap_space));
-        cur_disk = cur_disk->next;
-        cur_disk->pid = -1;
-        cur_disk->page = -1;
-        cur_disk->frame = -1;
-        cur_disk->block = i;
-        cur_disk->sector = i * (pageSize / sectorSize);
-    }
-    cur_disk->next = NULL;
-    initialized = 1;
-    return result;
+    if(limit < 0){
+        return P3_INVALID_NUM_FRAMES;
+    }
+    frame_limit[pid] = limit;
+    local_hand[pid] = -1;
+    return P1_SUCCESS;
 }
 
 /*
  *----------------------------------------------------------------------
  *
- * P3SwapFreeAll --
+ * P3FrameLimitReached --
  *
- *  Frees all swap space used by a process
+ *  Sets *reached to TRUE if pid has as many frames as its limit allows,
+ *  so its next page has to replace one of its own.
  *
  * Results:
- *   P3_NOT_INITIALIZED:    P3SwapInit has not been called
- *   P1_INVALID_PID:        pid is invalid      
- *   P1_SUCCESS:            success
+ *   P3_NOT_INITIALIZED:     P3SwapInit has not been called
+ *   P1_INVALID_PID:         pid is invalid
+ *   P1_SUCCESS:             success
  *
  *----------------------------------------------------------------------
  */
-
 int
-P3SwapFreeAll(int pid)
+P3FrameLimitReached(PID pid, int *reached)
 {
-    int result = P1_SUCCESS;
-    swap_space *cur = head_disk;
-    // free all swap space used by the process
     if(initialized == 0){
         return P3_NOT_INITIALIZED;
     }
-    while(cur->next !- NULL){
-        if(cur->pid == pid){
-            cur->pid = -1;
-            cur->page = -1
-        }
-        cur = cur->next;
+    if(pid < 0 || pid >= P1_MAXPROC){
+        return P1_INVALID_PID;
     }
-
-    return result;
+    *reached = frame_limit[pid] > 0 && resident[pid] >= frame_limit[pid];
+    return P1_SUCCESS;
 }
 
 /*
  *----------------------------------------------------------------------
  *
- * P3SwapOut --
+ * P3FramePin --
  *
- * Uses the clock algorithm to select a frame to replace, writing the page that is in the frame out 
- * to swap if it is dirty. The page table of the page’s process is modified so that the page no 
- * longer maps to the frame. The frame that was selected is returned in *frame. 
+ *  Adds delta to the number of pinned pages in frame. While it has any
+ *  the frame is not replaced or merged with another.
  *
  * Results:
- *   P3_NOT_INITIALIZED:    P3SwapInit has not been called
- *   P1_OUT_OF_SWAP:        there is no more swap space
- *   P1_SUCCESS:            success
+ *   P3_NOT_INITIALIZED:     P3SwapInit has not been called
+ *   P3_INVALID_FRAME:       frame is invalid
+ *   P1_SUCCESS:             success
  *
  *----------------------------------------------------------------------
  */
 int
-P3SwapOut(int *frame) 
+P3FramePin(int frame, int delta)
 {
-    /*****************
+    memory_node *node;
 
-    static int hand = -1;    // initially start with frame 0
-    if not initialized
-        return P3_NOT_INITIALIZED
-    loop
-        hand = (hand + 1) % numFrames
-        get access bits for the frame indicated by hand (USLOSS_MmuGetAccess)
-        if reference bit is not set in the access bits
-            frame = hand
-            break
-        else
-            clear frame's reference bit (USLOSS_MmuSetAccess)
-    page = page that's in the selected frame
-    pid = pid of the page
-    if page doesn't already have swap space
-        if there is free swap space
-            allocate swap space for the page
-        else
-            return P3_OUT_OF_SWAP
-    if dirty bit is set in the access bits or page isn't in swap space
-        write page to its swap space (P2_DiskWrite)
-        clear frame's dirty bit (USLOSS_MmuSetAccess)
-    get page table for pid (P3PageTableGet)
-    update page's PTE to indicate page is no longer in the frame
+    if(initialized == 0){
+        return P3_NOT_INITIALIZED;
+    }
+    if(frame < 0 || frame >= numFrames){
+        return P3_INVALID_FRAME;
+    }
+    node = FrameNode(frame);
+    if(node->pins == 0 && delta > 0){
+        BitSet(pinned, frame);
+        P3_vmStats.pinnedFrames++;
+    }
+    node->pins += delta;
+    assert(node->pins >= 0);
+    if(node->pins == 0 && delta < 0){
+        BitClear(pinned, frame);
+        P3_vmStats.pinnedFrames--;
+    }
+    return P1_SUCCESS;
+}
 
-    *****************/
-    static int hand = -1;
-    int access_bits, rc, page, pid, page_in_swap = 0;
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3ProcessSwapOut --
+ *
+ *  Swaps out every page of pid that has a frame to itself, for a process
+ *  that has been blocked a long time, and puts the frames back in the
+ *  free frame pool. The pages are saved the way P3SwapOut saves them, but
+ *  all at once and in page order, so the writes of adjacent blocks are
+ *  merged into a few long transfers. Pages that share their frame, are in
+ *  a shared region, are pinned, or have I/O outstanding are left alone.
+ *  *count is set to the number of pages swapped out.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:     P3SwapInit has not been called
+ *   P1_INVALID_PID:         pid is invalid
+ *   P3_OUT_OF_SWAP:         there is no more swap space, the pages
+ *                           before the one that didn't fit are out
+ *   P1_SUCCESS:             success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3ProcessSwapOut(PID pid, int *count)
+{
     USLOSS_PTE *table;
-    memory_node *cur_mem = head_memory;
-    swap_space *cur_disk = head_disk, free_block = NULL;
-    // error check
-    it(initialized == 0){
+    memory_node *node;
+    swap_entry *entry;
+    int page, frame, access_bits, rc;
+
+    if(initialized == 0){
         return P3_NOT_INITIALIZED;
     }
-    // checks for frame to overwrite
-    while(1){
-        hand = (hand + 1) % numFrames;
-        rc = USLOSS_MmuGetAccess(hand, &access_bits);
-        assert(rc == USLOSS_MMU_OK);
-        // if refererence bit is not set
-        if(access_bits == 0 || access_bits == 2){
-            frame = hand;
-            break;
-        }
-        // if reference bit is set, set it to 0
-        else{
-            rc = USLOSS_MmuSetAccess(hand, (access_bits - 1));
-            assert(rc == USLOSS_MMU_OK);
-        }
+    *count = 0;
+    rc = P3PageTableGet(pid, &table);
+    if(rc != P1_SUCCESS){
+        return rc;
     }
-    // gets the frame to be swapped
-    while(cur_mem->frame != frame){
-        cur_mem = cur_mem->next;
+    if(table == NULL){
+        return P1_SUCCESS;
     }
-    // set page and pid (stored in frame being swapped)
-    page = cur_mem->page;
-    pid = cur_mem->pid;
-    // goes through disk structure to see if page is in disk
-    while(cur_disk->next != NULL){
-        cur_disk = cur_disk->next;
-        // is the page looking at the page being swapped out
-        if(cur_disk->page == page){
-            page_in_swap = 1;
-            break;
-        }
-        // if no page in block make not of free block
-        if(cur_disk->page == -1){
-            free_block = cur_disk;
+    for(page = 0; page < numPages; page++){
+        if(!table[page].incore){
+            continue;
         }
-    }
-    // if the page is not in disk
-    if(page_in_swap == 0){
-        // allocates block
-        if(free_block != NULL){
-            free_block->pid = pid;
-            free_block->page = page;
+        frame = table[page].frame;
+        node = FrameNode(frame);
+        if(node->pid != pid || node->page != page || node->sharers != NULL
+            || node->region != NULL || node->io > 0 || node->pins > 0){
+            continue;
         }
-        // out of swap if no more memory
-        else{
-            return P3_OUT_OF_SWAP;
+        entry = SwapEntry(pid, page);
+        rc = USLOSS_MmuGetAccess(frame, &access_bits);
+        assert(rc == USLOSS_MMU_OK);
+        if((access_bits & USLOSS_MMU_DIRTY) || EntryEmpty(entry)){
+            rc = EntrySave(entry, node);
+            if(rc != P1_SUCCESS){
+                return rc;
+            }
         }
-    }
-    // if dirty bit is set
-    if(access_bits == 2 || access_bits == 3){
-        // write page to disk
-        rc = P2_DiskWrite(P3_SWAP_DISK, free_block->sector, sectorsInBlock, cur_mem->frame_address);
-        assert(rc == P1_SUCCESS);
-        // frame is no longer dirty since written to disk, so set dirty bit to 0
-        rc = USLOSS_MmuSetAccess(hand, (access_bits - 2))
+        P3_TP(P3_TP_VICTIM, pid, page, frame, -1, -1);
+        rc = USLOSS_MmuSetAccess(frame, 0);
         assert(rc == USLOSS_MMU_OK);
+        BitClear(ref_shadow, frame);
+        PageUnmap(pid, page);
+        FrameOwnerSet(node, -1);
+        node->page = -1;
+        // a write still going keeps the frame busy, whoever gets it next waits for it
+        P3FrameFree(frame);
+        (*count)++;
     }
-    // modify page table for pid
-    rc = P3PageTableGet(pid, &table);
-    assert(rc == P1_SUCCESS);
-    // incore is the bit that sets if in frame, 0 means its not in frame
-    table->incore = 0;
     return P1_SUCCESS;
 }
+
 /*
  *----------------------------------------------------------------------
  *
- * P3SwapIn --
+ * P3FrameFreeSet --
+ *
+ *  Called by phase3b when frame goes into its pool of free frames
+ *  (is_free is TRUE) or is taken out of it, so the clock never picks a
+ *  free frame. Calls before P3SwapInit are ignored, every frame starts
+ *  out free.
+ *
+ *----------------------------------------------------------------------
+ */
+void
+P3FrameFreeSet(int frame, int is_free)
+{
+    if(initialized == 0){
+        return;
+    }
+    assert(frame >= 0 && frame < numFrames);
+    if(is_free){
+        BitSet(free_map, frame);
+    }
+    else{
+        BitClear(free_map, frame);
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
  *
+ * P3FrameBusy --
+ *
+ *  Sets *busy to TRUE if frame has swap I/O outstanding, FALSE if not.
+ *  P3FrameIoDone is called when the last of it is done.
  *
  * Results:
  *   P3_NOT_INITIALIZED:     P3SwapInit has not been called
- *   P1_INVALID_PID:         pid is invalid      
- *   P1_INVALID_PAGE:        page is invalid         
- *   P1_INVALID_FRAME:       frame is invalid
- *   P3_PAGE_NOT_FOUND:      page is not in swap
+ *   P3_INVALID_FRAME:       frame is invalid
  *   P1_SUCCESS:             success
  *
  *----------------------------------------------------------------------
  */
 int
-P3SwapIn(int pid, int page, int frame)
+P3FrameBusy(int frame, int *busy)
 {
-    int pageInDisk = 0;
-    memory_node *cur = head_memory;
-    swap_space *cur_disk = head_disk;
-    /*****************
+    if(initialized == 0){
+        return P3_NOT_INITIALIZED;
+    }
+    if(frame < 0 || frame >= numFrames){
+        return P3_INVALID_FRAME;
+    }
+    *busy = BitTest(io_busy, frame);
+    return P1_SUCCESS;
+}
 
-    if not initialized
-        return P3_NOT_INITIALIZED
-    record that frame holds pid,page for use in P3SwapOut
-    if page is on swap disk
-        read page from swap disk into frame (P2_DiskRead)
-        return P1_SUCCESS
-    else
-        return P3_PAGE_NOT_FOUND        
+// the index in units of disk unit unit, starting a queue for it if it doesn't have one
+static int
+MapUnit(int unit)
+{
+    int i;
+
+    for(i = numUnits; i < numIOUnits; i++){
+        if(units[i].unit == unit){
+            return i;
+        }
+    }
+    units[numIOUnits].unit = unit;
+    units[numIOUnits].blocks = 0;
+    units[numIOUnits].slots = NULL;
+    UnitStart(&units[numIOUnits]);
+    return numIOUnits++;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3MapCreate --
+ *
+ *  Maps count of pid's pages starting at page to the page sized blocks
+ *  of disk unit starting at block, e.g. a data image made with
+ *  Disk_Create. A fault on one of the pages reads it from its block
+ *  rather than giving it a zeroed frame. When the page is replaced it
+ *  is dropped if it is clean and written back to its block if it is
+ *  dirty, without using swap. The unit can't be one of the swap units,
+ *  and the pages can't have been used yet.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:     P3SwapInit has not been called
+ *   P1_INVALID_PID:         pid is invalid
+ *   P3_INVALID_PAGE:        the pages are invalid or have been used
+ *   P3_INVALID_MAPPING:     unit is invalid or a swap unit, or the
+ *                           blocks aren't all on it
+ *   P1_SUCCESS:             success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3MapCreate(PID pid, int page, int count, int unit, int block)
+{
+    USLOSS_PTE *table;
+    swap_space *mapped;
+    swap_entry *entry;
+    int sectorSize, numSectors;
+    int rc, i, index;
 
-    *****************/
     if(initialized == 0){
         return P3_NOT_INITIALIZED;
     }
-    // moves to the specified frame
-    while(cur->frame != frame){
-        cur = cur->next;
+    if(pid < 0 || pid >= P1_MAXPROC){
+        return P1_INVALID_PID;
     }
-    // sets the page and pid of the frame
-    cur->page = page;
-    cur->pid = pid;\
-    // looks for the page in the disk. If doesn't find page returns P3_PAGE_NOT_FOUND
-    while(cur_disk->next != NULL){
-        if(cur_disk->page == page){
-            pageInDisk = 1;
-            break;
+    if(count <= 0 || page < 0 || page + count > numPages){
+        return P3_INVALID_PAGE;
+    }
+    if(unit < 0 || unit >= USLOSS_DISK_UNITS || (P3_swapUnits & (1 << unit)) || block < 0){
+        return P3_INVALID_MAPPING;
+    }
+    rc = P2_DiskSize(unit, &sectorSize, &numSectors);
+    if(rc != P1_SUCCESS || (block + count) * sectorsInBlock > numSectors){
+        return P3_INVALID_MAPPING;
+    }
+    rc = P3PageTableGet(pid, &table);
+    if(rc != P1_SUCCESS || table == NULL){
+        return P1_INVALID_PID;
+    }
+    for(i = 0; i < count; i++){
+        entry = SwapEntry(pid, page + i);
+        if(table[page + i].incore || !EntryEmpty(entry) || entry->region != NULL){
+            return P3_INVALID_PAGE;
         }
-        cur_disk = cur_disk->next;
     }
-    // if page is in disk read the page into the frame
-    if(pageInDisk == 1){
-        rc = P2_DiskRead(P3_SWAP_DISK, cur_disk->sector, sectorsInBlock, cur->frame_address);
-        return P1_SUCCESS;
+    index = MapUnit(unit);
+    for(i = 0; i < count; i++){
+        mapped = (swap_space *)malloc(sizeof(swap_space));
+        mapped->pid = pid;
+        mapped->page = page + i;
+        mapped->block = -1;
+        mapped->unit = index;
+        mapped->sector = (block + i) * sectorsInBlock;
+        mapped->refs = 0;
+        mapped->writes = 0;
+        mapped->mapped = TRUE;
+        mapped->next = NULL;
+        EntrySetBlock(SwapEntry(pid, page + i), mapped);
     }
-    else{
-        return P3_PAGE_NOT_FOUND
+    P3_vmStats.mappedPages += count;
+    return P1_SUCCESS;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * P3MapSync --
+ *
+ *  Writes pid's mapped pages that are in memory and dirty back to their
+ *  blocks, e.g. before its frames are freed when it quits. Pages in a
+ *  shared region are written back when the region is freed.
+ *
+ * Results:
+ *   P3_NOT_INITIALIZED:     P3SwapInit has not been called
+ *   P1_INVALID_PID:         pid is invalid
+ *   P1_SUCCESS:             success
+ *
+ *----------------------------------------------------------------------
+ */
+int
+P3MapSync(PID pid)
+{
+    USLOSS_PTE *table;
+    memory_node *node;
+    int rc, page;
+
+    if(initialized == 0){
+        return P3_NOT_INITIALIZED;
     }
-}
\ No newline at end of file
+    if(pid < 0 || pid >= P1_MAXPROC){
+        return P1_INVALID_PID;
+    }
+    rc = P3PageTableGet(pid, &table);
+    if(rc != P1_SUCCESS || table == NULL){
+        return rc;
+    }
+    for(page = 0; page < numPages; page++){
+        if(!table[page].incore){
+            continue;
+        }
+        node = FrameNode(table[page].frame);
+        if(node->pid == pid && node->page == page && node->region == NULL){
+            MapWriteBack(SwapEntry(pid, page), node);
+        }
+    }
+    return P1_SUCCESS;
+}
@@ -0,0 +1,144 @@
+/*
+ * test_compact.c
+ *
+ *  Swap compaction test. A long-lived child "L" and three short-lived children write
+ *  patterns that differ on every byte into their pages at the same time, so their swap
+ *  blocks end up interleaved on the disk. The short-lived children then quit, leaving
+ *  holes between L's blocks. L sleeps long enough for the compactor to pack its blocks
+ *  together, then checks its pages. At the end the test prints how many blocks were moved
+ *  and the swap fragmentation.
+ *
+ */
+#include <usyscall.h>
+#include <libuser.h>
+#include <assert.h>
+#include <usloss.h>
+#include <stdlib.h>
+#include <phase3.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase3Int.h"
+
+#define PAGES 6         // # of pages per process
+#define FRAMES 4
+#define PAGERS 1        // # of pagers
+#define SLEEP 4         // seconds L sleeps while swap is compacted
+
+static char *vmRegion;
+static char *names[] = {"L","A","B","C"};   // L is the long-lived child
+static int  numChildren = sizeof(names) / sizeof(char *);
+static int  pageSize;
+
+static int passed = FALSE;
+
+#ifdef DEBUG
+static int debugging = 1;
+#else
+static int debugging = 0;
+#endif /* DEBUG */
+
+static void
+Debug(char *fmt, ...)
+{
+    va_list ap;
+
+    if (debugging) {
+        va_start(ap, fmt);
+        USLOSS_VConsole(fmt, ap);
+    }
+}
+
+static char
+Pattern(char name, int page, int k)
+{
+    return name + page + k;
+}
+
+static int
+Child(void *arg)
+{
+    volatile char *name = (char *) arg;
+    int     j;
+    char    *page;
+    int     rc;
+    int     pid;
+
+    Sys_GetPid(&pid);
+    Debug("Child \"%s\" (%d) starting.\n", name, pid);
+
+    for (j = 0; j < PAGES; j++) {
+        page = vmRegion + j * pageSize;
+        Debug("Child \"%s\" (%d) writing to page %d @ %p\n", name, pid, j, page);
+        for (int k = 0; k < pageSize; k++) {
+            page[k] = Pattern(*name, j, k);
+        }
+        // let the others write a page too, so the blocks are interleaved
+        rc = Sys_Sleep(1);
+        assert(rc == P1_SUCCESS);
+    }
+    if (*name == 'L') {
+        rc = Sys_Sleep(SLEEP);
+        assert(rc == P1_SUCCESS);
+        for (j = 0; j < PAGES; j++) {
+            page = vmRegion + j * pageSize;
+            Debug("Child \"%s\" (%d) reading from page %d @ %p\n", name, pid, j, page);
+            for (int k = 0; k < pageSize; k++) {
+                TEST(page[k], Pattern(*name, j, k));
+            }
+        }
+    }
+    Debug("Child \"%s\" (%d) done.\n", name, pid);
+    return 0;
+}
+
+
+int
+P4_Startup(void *arg)
+{
+    int     i;
+    int     rc;
+    int     pid;
+    int     status;
+
+    Debug("P4_Startup starting.\n");
+    rc = Sys_VmInit(PAGES, PAGES, FRAMES, PAGERS, (void **) &vmRegion, &pageSize);
+    TEST(rc, P1_SUCCESS);
+
+    for (i = 0; i < numChildren; i++) {
+        rc = Sys_Spawn(names[i], Child, (void *) names[i], USLOSS_MIN_STACK * 4, 3, &pid);
+        assert(rc == P1_SUCCESS);
+    }
+    for (i = 0; i < numChildren; i++) {
+        rc = Sys_Wait(&pid, &status);
+        assert(rc == P1_SUCCESS);
+        TEST(status, 0);
+    }
+    Debug("Children terminated\n");
+    USLOSS_Console("%d blocks compacted, fragmentation %d%%\n", P3_vmStats.compacted,
+                   P3_vmStats.fragmentation);
+    Sys_VmShutdown();
+    passed = TRUE;
+    return 0;
+}
+
+
+void test_setup(int argc, char **argv) {
+    char options[64];
+    DeleteAllDisks();
+    int rc = Disk_Create(NULL, P3_SWAP_DISK, numChildren * PAGES);
+    assert(rc == 0);
+    snprintf(options, sizeof(options), "compactInterval=%d", P3_COMPACT_INTERVAL);
+    setenv("P3_VM_OPTIONS", options, 1);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        PASSED_FINISH();
+    }
+}
+
+void finish(int argc, char **argv) {}
@@ -0,0 +1,125 @@
+/*
+ * test_frame_reuse.c
+ *
+ *  Frame reuse test. Child "A" writes one page and sleeps long enough for the Harvester to
+ *  collect the page's reference bit, then quits, which frees its frame with the bit still
+ *  set. Child "B" writes one page per frame, the first of which gets A's frame, then writes
+ *  one more page. That fault has to replace one of B's pages, all of which were referenced
+ *  once, so the clock goes around once and picks the first frame it comes to, the one that
+ *  was A's. If the bit A left behind were taken for B's, B's first page would start out
+ *  referenced and another page would be picked instead. The test checks that B's first page
+ *  is the one that was replaced, so touching it again faults.
+ *
+ */
+#include <usyscall.h>
+#include <libuser.h>
+#include <assert.h>
+#include <usloss.h>
+#include <stdlib.h>
+#include <phase3.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase3Int.h"
+
+#define FRAMES 4
+#define PAGES (FRAMES + 1)  // # of pages per process
+#define PAGERS 1            // # of pagers
+#define SLEEP (2 * P3_HARVEST_INTERVAL + 1)  // seconds A sleeps
+
+static char *vmRegion;
+static int  pageSize;
+
+static int passed = FALSE;
+
+static char
+Pattern(char name, int page, int k)
+{
+    return name + page + k;
+}
+
+static void
+Write(char name, int j)
+{
+    char    *page = vmRegion + j * pageSize;
+
+    for (int k = 0; k < pageSize; k++) {
+        page[k] = Pattern(name, j, k);
+    }
+}
+
+static int
+Harvested(void *arg)
+{
+    int     rc;
+
+    Write('A', 0);
+    rc = Sys_Sleep(SLEEP);
+    assert(rc == P1_SUCCESS);
+    return 0;
+}
+
+static int
+Reuser(void *arg)
+{
+    char    *page;
+    int     faults;
+
+    for (int j = 0; j < PAGES; j++) {
+        Write('B', j);
+    }
+    faults = P3_vmStats.faults;
+    page = vmRegion;
+    for (int k = 0; k < pageSize; k++) {
+        TEST(page[k], Pattern('B', 0, k));
+    }
+    TEST(P3_vmStats.faults, faults + 1);
+    return 0;
+}
+
+int
+P4_Startup(void *arg)
+{
+    int     rc;
+    int     pid;
+    int     status;
+
+    rc = Sys_VmInit(PAGES, PAGES, FRAMES, PAGERS, (void **) &vmRegion, &pageSize);
+    TEST(rc, P1_SUCCESS);
+
+    rc = Sys_Spawn("A", Harvested, NULL, USLOSS_MIN_STACK * 4, 3, &pid);
+    assert(rc == P1_SUCCESS);
+    rc = Sys_Wait(&pid, &status);
+    assert(rc == P1_SUCCESS);
+    TEST(status, 0);
+
+    rc = Sys_Spawn("B", Reuser, NULL, USLOSS_MIN_STACK * 4, 3, &pid);
+    assert(rc == P1_SUCCESS);
+    rc = Sys_Wait(&pid, &status);
+    assert(rc == P1_SUCCESS);
+    TEST(status, 0);
+    Sys_VmShutdown();
+    passed = TRUE;
+    return 0;
+}
+
+
+void test_setup(int argc, char **argv) {
+    char options[64];
+    DeleteAllDisks();
+    int rc = Disk_Create(NULL, P3_SWAP_DISK, 2 * PAGES);
+    assert(rc == 0);
+    snprintf(options, sizeof(options), "harvestInterval=%d", P3_HARVEST_INTERVAL);
+    setenv("P3_VM_OPTIONS", options, 1);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        PASSED_FINISH();
+    }
+}
+
+void finish(int argc, char **argv) {}
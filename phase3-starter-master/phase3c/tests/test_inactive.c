@@ -0,0 +1,103 @@
+/*
+ * test_inactive.c
+ *
+ *  Inactive list test. A child writes a pattern that differs on every byte into one more
+ *  page than there are frames, then goes around its pages checking them. Each fault unmaps
+ *  the page the clock picks onto the inactive list and takes the frame of the page that was
+ *  there before, and going around the pages in order the next one is often the page that
+ *  was just unmapped, so some of the faults are soft faults that only map it back. At the
+ *  end the test prints the soft and hard faults.
+ *
+ */
+#include <usyscall.h>
+#include <libuser.h>
+#include <assert.h>
+#include <usloss.h>
+#include <stdlib.h>
+#include <phase3.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase3Int.h"
+
+#define FRAMES 4
+#define PAGES (FRAMES + 1)  // # of pages per process
+#define PAGERS 1            // # of pagers
+#define ROUNDS 4            // # of times the child goes around its pages
+
+static char *vmRegion;
+static int  pageSize;
+
+static int passed = FALSE;
+
+static char
+Pattern(int page, int k)
+{
+    return 'A' + page + k;
+}
+
+static int
+Child(void *arg)
+{
+    int     i,j;
+    char    *page;
+
+    for (j = 0; j < PAGES; j++) {
+        page = vmRegion + j * pageSize;
+        for (int k = 0; k < pageSize; k++) {
+            page[k] = Pattern(j, k);
+        }
+    }
+    for (i = 0; i < ROUNDS; i++) {
+        for (j = 0; j < PAGES; j++) {
+            page = vmRegion + j * pageSize;
+            for (int k = 0; k < pageSize; k++) {
+                TEST(page[k], Pattern(j, k));
+            }
+        }
+    }
+    return 0;
+}
+
+
+int
+P4_Startup(void *arg)
+{
+    int     rc;
+    int     pid;
+    int     status;
+
+    rc = Sys_VmInit(PAGES, PAGES, FRAMES, PAGERS, (void **) &vmRegion, &pageSize);
+    TEST(rc, P1_SUCCESS);
+
+    rc = Sys_Spawn("Child", Child, NULL, USLOSS_MIN_STACK * 4, 3, &pid);
+    assert(rc == P1_SUCCESS);
+    rc = Sys_Wait(&pid, &status);
+    assert(rc == P1_SUCCESS);
+    TEST(status, 0);
+    USLOSS_Console("%d soft faults, %d hard faults\n", P3_vmStats.softFaults,
+                   P3_vmStats.hardFaults);
+    TEST(P3_vmStats.softFaults > 0, TRUE);
+    Sys_VmShutdown();
+    passed = TRUE;
+    return 0;
+}
+
+
+void test_setup(int argc, char **argv) {
+    DeleteAllDisks();
+    int rc = Disk_Create(NULL, P3_SWAP_DISK, PAGES);
+    assert(rc == 0);
+    P3_inactivePercent = P3_INACTIVE_PERCENT;
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        PASSED_FINISH();
+    }
+}
+
+void finish(int argc, char **argv) {}
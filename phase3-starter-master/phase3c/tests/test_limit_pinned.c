@@ -0,0 +1,121 @@
+/*
+ * test_limit_pinned.c
+ *
+ *  Frame limit and pinning test. Every process is limited to LIMIT frames. The child fills
+ *  LIMIT pages, pins them all, and then writes two more pages. It has nothing of its own it
+ *  can replace on the first of them, so that fault takes it over its limit with a frame
+ *  from the free pool. The second one replaces the first, the only page of its own that
+ *  isn't pinned. The free frames should be counted right, and all of the child's pages
+ *  should still hold what it wrote.
+ *
+ */
+#include <usyscall.h>
+#include <libuser.h>
+#include <assert.h>
+#include <usloss.h>
+#include <stdlib.h>
+#include <phase3.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase3Int.h"
+
+#define FRAMES 8
+#define LIMIT 2             // # of frames a process may have
+#define PAGES (LIMIT + 2)   // # of pages per process
+#define PAGERS 1            // # of pagers
+
+static char *vmRegion;
+static int  pageSize;
+
+static int passed = FALSE;
+
+static char
+Pattern(int page, int k)
+{
+    return 'A' + page + k;
+}
+
+static void
+Write(int first, int end)
+{
+    char    *page;
+
+    for (int j = first; j < end; j++) {
+        page = vmRegion + j * pageSize;
+        for (int k = 0; k < pageSize; k++) {
+            page[k] = Pattern(j, k);
+        }
+    }
+}
+
+static int
+Child(void *arg)
+{
+    int     rc;
+    int     pid;
+    char    *page;
+
+    rc = Sys_GetPid(&pid);
+    assert(rc == P1_SUCCESS);
+    Write(0, LIMIT);
+    rc = P3_VmLock(pid, 0, LIMIT);
+    TEST(rc, P1_SUCCESS);
+    TEST(P3_vmStats.pinnedFrames, LIMIT);
+    Write(LIMIT, PAGES);
+    TEST(P3_vmStats.freeFrames, FRAMES - LIMIT - 1);
+    TEST(P3_vmStats.replaced, 1);
+    for (int j = 0; j < PAGES; j++) {
+        page = vmRegion + j * pageSize;
+        for (int k = 0; k < pageSize; k++) {
+            TEST(page[k], Pattern(j, k));
+        }
+    }
+    TEST(P3_vmStats.freeFrames, FRAMES - LIMIT - 1);
+    rc = P3_VmUnlock(pid, 0, LIMIT);
+    TEST(rc, P1_SUCCESS);
+    return 0;
+}
+
+
+int
+P4_Startup(void *arg)
+{
+    int     rc;
+    int     pid;
+    int     status;
+
+    rc = Sys_VmInit(PAGES, PAGES, FRAMES, PAGERS, (void **) &vmRegion, &pageSize);
+    TEST(rc, P1_SUCCESS);
+
+    rc = Sys_Spawn("Child", Child, NULL, USLOSS_MIN_STACK * 4, 3, &pid);
+    assert(rc == P1_SUCCESS);
+    rc = Sys_Wait(&pid, &status);
+    assert(rc == P1_SUCCESS);
+    TEST(status, 0);
+    TEST(P3_vmStats.freeFrames, FRAMES);
+    Sys_VmShutdown();
+    passed = TRUE;
+    return 0;
+}
+
+
+void test_setup(int argc, char **argv) {
+    char options[64];
+    DeleteAllDisks();
+    int rc = Disk_Create(NULL, P3_SWAP_DISK, PAGES);
+    assert(rc == 0);
+    snprintf(options, sizeof(options), "frameLimit=%d", LIMIT);
+    setenv("P3_VM_OPTIONS", options, 1);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        PASSED_FINISH();
+    }
+}
+
+void finish(int argc, char **argv) {}
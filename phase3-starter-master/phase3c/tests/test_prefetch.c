@@ -0,0 +1,109 @@
+/*
+ * test_prefetch.c
+ *
+ *  Stride prefetch test. Child "A" writes a pattern into twice as many pages as there are
+ *  frames, so the first half ends up in swap. It then reads every STRIDE-th page going
+ *  forward and every page going backward, which the pager should pick up as streams and
+ *  prefetch. A checks every page it reads, and the test checks that pages were prefetched.
+ *
+ */
+#include <usyscall.h>
+#include <libuser.h>
+#include <assert.h>
+#include <usloss.h>
+#include <stdlib.h>
+#include <phase3.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase3Int.h"
+
+#define PAGES 32        // # of pages per process
+#define FRAMES (PAGES / 2)
+#define PAGERS 1        // # of pagers
+#define STRIDE 3
+
+static char *vmRegion;
+static int  pageSize;
+
+static int passed = FALSE;
+
+static char
+Pattern(int page, int k)
+{
+    return 'A' + page + k;
+}
+
+static void
+Check(int j)
+{
+    char    *page = vmRegion + j * pageSize;
+
+    for (int k = 0; k < pageSize; k++) {
+        TEST(page[k], Pattern(j, k));
+    }
+}
+
+static int
+Child(void *arg)
+{
+    char    *page;
+    int     j;
+
+    for (j = 0; j < PAGES; j++) {
+        page = vmRegion + j * pageSize;
+        for (int k = 0; k < pageSize; k++) {
+            page[k] = Pattern(j, k);
+        }
+    }
+    for (j = 0; j < PAGES; j += STRIDE) {
+        Check(j);
+    }
+    for (j = PAGES - 1; j >= 0; j--) {
+        Check(j);
+    }
+    return 0;
+}
+
+int
+P4_Startup(void *arg)
+{
+    int     rc;
+    int     pid;
+    int     status;
+
+    rc = Sys_VmInit(PAGES, PAGES, FRAMES, PAGERS, (void **) &vmRegion, &pageSize);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_Spawn("A", Child, NULL, USLOSS_MIN_STACK * 4, 3, &pid);
+    assert(rc == P1_SUCCESS);
+    rc = Sys_Wait(&pid, &status);
+    assert(rc == P1_SUCCESS);
+    TEST(status, 0);
+    USLOSS_Console("%d faults, %d pages prefetched, %d wasted\n", P3_vmStats.faults,
+                   P3_vmStats.prefetched, P3_vmStats.prefetchWasted);
+    TEST(P3_vmStats.prefetched > 0, TRUE);
+    Sys_VmShutdown();
+    passed = TRUE;
+    return 0;
+}
+
+
+void test_setup(int argc, char **argv) {
+    char options[64];
+    DeleteAllDisks();
+    int rc = Disk_Create(NULL, P3_SWAP_DISK, PAGES);
+    assert(rc == 0);
+    snprintf(options, sizeof(options), "prefetch=%d", P3_PREFETCH_MAX);
+    setenv("P3_VM_OPTIONS", options, 1);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        PASSED_FINISH();
+    }
+}
+
+void finish(int argc, char **argv) {}
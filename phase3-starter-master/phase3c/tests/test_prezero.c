@@ -0,0 +1,111 @@
+/*
+ * test_prezero.c
+ *
+ *  Pre-zeroed frame test. Child "A" writes every byte of its pages and quits, freeing its
+ *  frames. While everyone sleeps the zeroer zeroes them, so child "B" gets a pre-zeroed
+ *  frame for every one of its new pages. B checks that its pages read as zeros. The zeroer
+ *  is off by default, the test turns it on through P3_VM_OPTIONS.
+ *
+ */
+#include <usyscall.h>
+#include <libuser.h>
+#include <assert.h>
+#include <usloss.h>
+#include <stdlib.h>
+#include <phase3.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase3Int.h"
+
+#define PAGES 4         // # of pages per process
+#define FRAMES PAGES
+#define PAGERS 1        // # of pagers
+#define SLEEP 2         // seconds to let the zeroer run
+
+static char *vmRegion;
+static int  pageSize;
+
+static int passed = FALSE;
+
+static int
+Writer(void *arg)
+{
+    char    *page;
+
+    for (int j = 0; j < PAGES; j++) {
+        page = vmRegion + j * pageSize;
+        for (int k = 0; k < pageSize; k++) {
+            page[k] = 'A' + j + k;
+        }
+    }
+    return 0;
+}
+
+static int
+Reader(void *arg)
+{
+    char    *page;
+
+    for (int j = 0; j < PAGES; j++) {
+        page = vmRegion + j * pageSize;
+        for (int k = 0; k < pageSize; k++) {
+            TEST(page[k], 0);
+        }
+    }
+    return 0;
+}
+
+static void
+Run(char *name, int (*func)(void *))
+{
+    int     rc;
+    int     pid;
+    int     status;
+
+    rc = Sys_Spawn(name, func, NULL, USLOSS_MIN_STACK * 4, 3, &pid);
+    assert(rc == P1_SUCCESS);
+    rc = Sys_Wait(&pid, &status);
+    assert(rc == P1_SUCCESS);
+    TEST(status, 0);
+}
+
+int
+P4_Startup(void *arg)
+{
+    int     rc;
+    int     before;
+
+    rc = Sys_VmInit(PAGES, PAGES, FRAMES, PAGERS, (void **) &vmRegion, &pageSize);
+    TEST(rc, P1_SUCCESS);
+    Run("A", Writer);
+    rc = Sys_Sleep(SLEEP);
+    assert(rc == P1_SUCCESS);
+    before = P3_vmStats.preZeroed;
+    Run("B", Reader);
+    TEST(P3_vmStats.preZeroed - before, PAGES);
+    USLOSS_Console("%d new pages pre-zeroed, %d zeroed inline\n", P3_vmStats.preZeroed,
+                   P3_vmStats.zeroedInline);
+    Sys_VmShutdown();
+    passed = TRUE;
+    return 0;
+}
+
+
+void test_setup(int argc, char **argv) {
+    DeleteAllDisks();
+    int rc = Disk_Create(NULL, P3_SWAP_DISK, 2 * PAGES);
+    assert(rc == 0);
+    setenv("P3_VM_OPTIONS", "zeroFrames=true", 1);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        PASSED_FINISH();
+    }
+}
+
+void finish(int argc, char **argv) {}
@@ -0,0 +1,147 @@
+/*
+ * test_swap_sched.c
+ *
+ *  Multi-process paging test for the swap disk scheduler. Four children each write a
+ *  pattern that differs on every byte into their pages (so the pages can't be stored as
+ *  fill values), sleep, then check them. There are fewer frames than pages so the pages
+ *  are constantly swapped in and out by all the children at once. At the end the test
+ *  prints how far the swap disk head moved and the mean I/O latency.
+ *
+ *  Run it with "fifo" as an argument (make TESTFLAGS=fifo tests) to use FIFO scheduling
+ *  instead of C-SCAN and compare the numbers.
+ *
+ */
+#include <usyscall.h>
+#include <libuser.h>
+#include <assert.h>
+#include <usloss.h>
+#include <stdlib.h>
+#include <phase3.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase3Int.h"
+
+#define PAGES 6         // # of pages per process
+#define FRAMES 4
+#define ITERATIONS 3
+#define PAGERS 1        // # of pagers
+
+static char *vmRegion;
+static char *names[] = {"A","B","C","D"};
+static int  numChildren = sizeof(names) / sizeof(char *);
+static int  pageSize;
+
+static int passed = FALSE;
+
+#ifdef DEBUG
+static int debugging = 1;
+#else
+static int debugging = 0;
+#endif /* DEBUG */
+
+static void
+Debug(char *fmt, ...)
+{
+    va_list ap;
+
+    if (debugging) {
+        va_start(ap, fmt);
+        USLOSS_VConsole(fmt, ap);
+    }
+}
+
+static char
+Pattern(char name, int iteration, int page, int k)
+{
+    return name + iteration + page + k;
+}
+
+static int
+Child(void *arg)
+{
+    volatile char *name = (char *) arg;
+    int     i,j;
+    char    *page;
+    int     rc;
+    int     pid;
+
+    Sys_GetPid(&pid);
+    Debug("Child \"%s\" (%d) starting.\n", name, pid);
+
+    for (i = 0; i < ITERATIONS; i++) {
+        for (j = 0; j < PAGES; j++) {
+            page = vmRegion + j * pageSize;
+            Debug("Child \"%s\" (%d) writing to page %d @ %p\n", name, pid, j, page);
+            for (int k = 0; k < pageSize; k++) {
+                page[k] = Pattern(*name, i, j, k);
+            }
+        }
+        rc = Sys_Sleep(1);
+        assert(rc == P1_SUCCESS);
+        for (j = 0; j < PAGES; j++) {
+            page = vmRegion + j * pageSize;
+            Debug("Child \"%s\" (%d) reading from page %d @ %p\n", name, pid, j, page);
+            for (int k = 0; k < pageSize; k++) {
+                TEST(page[k], Pattern(*name, i, j, k));
+            }
+        }
+    }
+    Debug("Child \"%s\" (%d) done.\n", name, pid);
+    return 0;
+}
+
+
+int
+P4_Startup(void *arg)
+{
+    int     i;
+    int     rc;
+    int     pid;
+    int     status;
+
+    Debug("P4_Startup starting.\n");
+    rc = Sys_VmInit(PAGES, PAGES, FRAMES, PAGERS, (void **) &vmRegion, &pageSize);
+    TEST(rc, P1_SUCCESS);
+
+    for (i = 0; i < numChildren; i++) {
+        rc = Sys_Spawn(names[i], Child, (void *) names[i], USLOSS_MIN_STACK * 4, 3, &pid);
+        assert(rc == P1_SUCCESS);
+    }
+    for (i = 0; i < numChildren; i++) {
+        rc = Sys_Wait(&pid, &status);
+        assert(rc == P1_SUCCESS);
+        TEST(status, 0);
+    }
+    Debug("Children terminated\n");
+    USLOSS_Console("%s: head travel %d tracks, %d requests in %d transfers, mean latency %d us\n",
+                   P3_swapSched == P3_SCHED_FIFO ? "FIFO" : "C-SCAN", P3_vmStats.ioSeek,
+                   P3_vmStats.ioRequests, P3_vmStats.ioTransfers,
+                   P3_vmStats.ioRequests > 0 ? P3_vmStats.ioWait / P3_vmStats.ioRequests : 0);
+    Sys_VmShutdown();
+    passed = TRUE;
+    return 0;
+}
+
+
+void test_setup(int argc, char **argv) {
+    DeleteAllDisks();
+    int rc = Disk_Create(NULL, P3_SWAP_DISK, numChildren * PAGES);
+    assert(rc == 0);
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "fifo") == 0) {
+            P3_swapSched = P3_SCHED_FIFO;
+        }
+    }
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        PASSED_FINISH();
+    }
+}
+
+void finish(int argc, char **argv) {}
@@ -0,0 +1,154 @@
+/*
+ * test_swap_stripe.c
+ *
+ *  Multi-process paging test for swap striped across both disk units. Four children each
+ *  write a pattern that differs on every byte into their pages (so the pages can't be
+ *  stored as fill values), sleep, then check them. There are fewer frames than pages so
+ *  the pages are constantly swapped in and out by all the children at once. At the end
+ *  the test prints the pages moved to and from swap per second.
+ *
+ *  Run it with "single" as an argument (make TESTFLAGS=single tests) to swap to
+ *  P3_SWAP_DISK only and compare the numbers.
+ *
+ */
+#include <usyscall.h>
+#include <libuser.h>
+#include <assert.h>
+#include <usloss.h>
+#include <stdlib.h>
+#include <phase3.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase3Int.h"
+
+#define PAGES 6         // # of pages per process
+#define FRAMES 4
+#define ITERATIONS 3
+#define PAGERS 1        // # of pagers
+
+static char *vmRegion;
+static char *names[] = {"A","B","C","D"};
+static int  numChildren = sizeof(names) / sizeof(char *);
+static int  pageSize;
+
+static int passed = FALSE;
+
+#ifdef DEBUG
+static int debugging = 1;
+#else
+static int debugging = 0;
+#endif /* DEBUG */
+
+static void
+Debug(char *fmt, ...)
+{
+    va_list ap;
+
+    if (debugging) {
+        va_start(ap, fmt);
+        USLOSS_VConsole(fmt, ap);
+    }
+}
+
+static char
+Pattern(char name, int iteration, int page, int k)
+{
+    return name + iteration + page + k;
+}
+
+static int
+Child(void *arg)
+{
+    volatile char *name = (char *) arg;
+    int     i,j;
+    char    *page;
+    int     rc;
+    int     pid;
+
+    Sys_GetPid(&pid);
+    Debug("Child \"%s\" (%d) starting.\n", name, pid);
+
+    for (i = 0; i < ITERATIONS; i++) {
+        for (j = 0; j < PAGES; j++) {
+            page = vmRegion + j * pageSize;
+            Debug("Child \"%s\" (%d) writing to page %d @ %p\n", name, pid, j, page);
+            for (int k = 0; k < pageSize; k++) {
+                page[k] = Pattern(*name, i, j, k);
+            }
+        }
+        rc = Sys_Sleep(1);
+        assert(rc == P1_SUCCESS);
+        for (j = 0; j < PAGES; j++) {
+            page = vmRegion + j * pageSize;
+            Debug("Child \"%s\" (%d) reading from page %d @ %p\n", name, pid, j, page);
+            for (int k = 0; k < pageSize; k++) {
+                TEST(page[k], Pattern(*name, i, j, k));
+            }
+        }
+    }
+    Debug("Child \"%s\" (%d) done.\n", name, pid);
+    return 0;
+}
+
+
+int
+P4_Startup(void *arg)
+{
+    int     i;
+    int     rc;
+    int     pid;
+    int     status;
+    int     start, elapsed;
+
+    Debug("P4_Startup starting.\n");
+    rc = Sys_VmInit(PAGES, PAGES, FRAMES, PAGERS, (void **) &vmRegion, &pageSize);
+    TEST(rc, P1_SUCCESS);
+
+    start = USLOSS_Clock();
+    for (i = 0; i < numChildren; i++) {
+        rc = Sys_Spawn(names[i], Child, (void *) names[i], USLOSS_MIN_STACK * 4, 3, &pid);
+        assert(rc == P1_SUCCESS);
+    }
+    for (i = 0; i < numChildren; i++) {
+        rc = Sys_Wait(&pid, &status);
+        assert(rc == P1_SUCCESS);
+        TEST(status, 0);
+    }
+    elapsed = USLOSS_Clock() - start;
+    Debug("Children terminated\n");
+    USLOSS_Console("%s: %d pageIns, %d pageOuts in %d us, %d pages/s\n",
+                   P3_swapUnits == (1 << P3_SWAP_DISK) ? "1 unit" : "2 units",
+                   P3_vmStats.pageIns, P3_vmStats.pageOuts, elapsed,
+                   (int) ((P3_vmStats.pageIns + P3_vmStats.pageOuts) * 1000000LL / elapsed));
+    Sys_VmShutdown();
+    passed = TRUE;
+    return 0;
+}
+
+
+void test_setup(int argc, char **argv) {
+    DeleteAllDisks();
+    // each unit has room for all the pages, so the test is the same with one unit
+    for (int unit = 0; unit < USLOSS_DISK_UNITS; unit++) {
+        int rc = Disk_Create(NULL, unit, numChildren * PAGES);
+        assert(rc == 0);
+    }
+    P3_swapUnits = (1 << USLOSS_DISK_UNITS) - 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "single") == 0) {
+            P3_swapUnits = 1 << P3_SWAP_DISK;
+        }
+    }
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        PASSED_FINISH();
+    }
+}
+
+void finish(int argc, char **argv) {}
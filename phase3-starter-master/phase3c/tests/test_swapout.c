@@ -0,0 +1,127 @@
+/*
+ * test_swapout.c
+ *
+ *  Whole-process swap-out test. Child "S" writes a pattern into its pages and goes to
+ *  sleep. Child "B" then uses every frame for its own pages for a while, so memory is
+ *  tight, and S, blocked the whole time, should be swapped out at once. When S wakes up it
+ *  checks its pages, which come back in one batch on its first fault.
+ *
+ */
+#include <usyscall.h>
+#include <libuser.h>
+#include <assert.h>
+#include <usloss.h>
+#include <stdlib.h>
+#include <phase3.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase3Int.h"
+
+#define PAGES 8         // # of pages per process
+#define FRAMES PAGES
+#define PAGERS 1        // # of pagers
+#define SLEEP (P3_SWAPOUT_IDLE + 4)     // seconds S sleeps
+#define ROUNDS (SLEEP - 1)              // seconds B keeps its pages busy
+
+static char *vmRegion;
+static int  pageSize;
+
+static int passed = FALSE;
+
+static char
+Pattern(char name, int page, int k)
+{
+    return name + page + k;
+}
+
+static void
+Write(char name)
+{
+    char    *page;
+
+    for (int j = 0; j < PAGES; j++) {
+        page = vmRegion + j * pageSize;
+        for (int k = 0; k < pageSize; k++) {
+            page[k] = Pattern(name, j, k);
+        }
+    }
+}
+
+static int
+Sleeper(void *arg)
+{
+    char    *page;
+    int     rc;
+
+    Write('S');
+    rc = Sys_Sleep(SLEEP);
+    assert(rc == P1_SUCCESS);
+    for (int j = 0; j < PAGES; j++) {
+        page = vmRegion + j * pageSize;
+        for (int k = 0; k < pageSize; k++) {
+            TEST(page[k], Pattern('S', j, k));
+        }
+    }
+    return 0;
+}
+
+static int
+Busy(void *arg)
+{
+    int     rc;
+
+    for (int i = 0; i < ROUNDS; i++) {
+        Write('B');
+        rc = Sys_Sleep(1);
+        assert(rc == P1_SUCCESS);
+    }
+    return 0;
+}
+
+int
+P4_Startup(void *arg)
+{
+    int     rc;
+    int     pid;
+    int     status;
+
+    rc = Sys_VmInit(PAGES, PAGES, FRAMES, PAGERS, (void **) &vmRegion, &pageSize);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_Spawn("S", Sleeper, NULL, USLOSS_MIN_STACK * 4, 3, &pid);
+    assert(rc == P1_SUCCESS);
+    rc = Sys_Spawn("B", Busy, NULL, USLOSS_MIN_STACK * 4, 3, &pid);
+    assert(rc == P1_SUCCESS);
+    for (int i = 0; i < 2; i++) {
+        rc = Sys_Wait(&pid, &status);
+        assert(rc == P1_SUCCESS);
+        TEST(status, 0);
+    }
+    USLOSS_Console("%d swap-outs of %d pages, %d pages brought back\n",
+                   P3_vmStats.procSwapOuts, P3_vmStats.procSwapPages, P3_vmStats.procSwapIns);
+    TEST(P3_vmStats.procSwapOuts > 0, TRUE);
+    Sys_VmShutdown();
+    passed = TRUE;
+    return 0;
+}
+
+
+void test_setup(int argc, char **argv) {
+    char options[64];
+    DeleteAllDisks();
+    int rc = Disk_Create(NULL, P3_SWAP_DISK, 2 * PAGES);
+    assert(rc == 0);
+    snprintf(options, sizeof(options), "swapOutIdle=%d", P3_SWAPOUT_IDLE);
+    setenv("P3_VM_OPTIONS", options, 1);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        PASSED_FINISH();
+    }
+}
+
+void finish(int argc, char **argv) {}
@@ -0,0 +1,129 @@
+/*
+ * test_wake.c
+ *
+ *  Wakeup prefetch test. Child "S" writes a pattern into its pages and goes to sleep,
+ *  and the swapper records the pages it has in memory. Child "B" then uses every frame for
+ *  its own pages, so S loses them while it sleeps. When S wakes up the pages it lost come
+ *  back in one batch, on its first fault or when the swapper sees it running, and it
+ *  checks them. Only prefetching is turned on, not whole-process swap-out, so only the
+ *  wakeup prefetch brings them back.
+ *
+ */
+#include <usyscall.h>
+#include <libuser.h>
+#include <assert.h>
+#include <usloss.h>
+#include <stdlib.h>
+#include <phase3.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase3Int.h"
+
+#define PAGES 8         // # of pages per process
+#define FRAMES PAGES
+#define PAGERS 1        // # of pagers
+#define SLEEP 3         // seconds S sleeps
+#define ROUNDS (SLEEP - 1)  // seconds B keeps its pages busy
+
+static char *vmRegion;
+static int  pageSize;
+
+static int passed = FALSE;
+
+static char
+Pattern(char name, int page, int k)
+{
+    return name + page + k;
+}
+
+static void
+Write(char name)
+{
+    char    *page;
+
+    for (int j = 0; j < PAGES; j++) {
+        page = vmRegion + j * pageSize;
+        for (int k = 0; k < pageSize; k++) {
+            page[k] = Pattern(name, j, k);
+        }
+    }
+}
+
+static int
+Sleeper(void *arg)
+{
+    char    *page;
+    int     rc;
+
+    Write('S');
+    rc = Sys_Sleep(SLEEP);
+    assert(rc == P1_SUCCESS);
+    for (int j = 0; j < PAGES; j++) {
+        page = vmRegion + j * pageSize;
+        for (int k = 0; k < pageSize; k++) {
+            TEST(page[k], Pattern('S', j, k));
+        }
+    }
+    return 0;
+}
+
+static int
+Busy(void *arg)
+{
+    int     rc;
+
+    for (int i = 0; i < ROUNDS; i++) {
+        Write('B');
+        rc = Sys_Sleep(1);
+        assert(rc == P1_SUCCESS);
+    }
+    return 0;
+}
+
+int
+P4_Startup(void *arg)
+{
+    int     rc;
+    int     pid;
+    int     status;
+
+    rc = Sys_VmInit(PAGES, PAGES, FRAMES, PAGERS, (void **) &vmRegion, &pageSize);
+    TEST(rc, P1_SUCCESS);
+    rc = Sys_Spawn("S", Sleeper, NULL, USLOSS_MIN_STACK * 4, 3, &pid);
+    assert(rc == P1_SUCCESS);
+    rc = Sys_Spawn("B", Busy, NULL, USLOSS_MIN_STACK * 4, 3, &pid);
+    assert(rc == P1_SUCCESS);
+    for (int i = 0; i < 2; i++) {
+        rc = Sys_Wait(&pid, &status);
+        assert(rc == P1_SUCCESS);
+        TEST(status, 0);
+    }
+    USLOSS_Console("%d faults, %d pages brought back on wakeup\n", P3_vmStats.faults,
+                   P3_vmStats.wakePrefetched);
+    TEST(P3_vmStats.wakePrefetched > 0, TRUE);
+    Sys_VmShutdown();
+    passed = TRUE;
+    return 0;
+}
+
+
+void test_setup(int argc, char **argv) {
+    char options[64];
+    DeleteAllDisks();
+    int rc = Disk_Create(NULL, P3_SWAP_DISK, 2 * PAGES);
+    assert(rc == 0);
+    snprintf(options, sizeof(options), "prefetch=%d", P3_PREFETCH_MAX);
+    setenv("P3_VM_OPTIONS", options, 1);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        PASSED_FINISH();
+    }
+}
+
+void finish(int argc, char **argv) {}
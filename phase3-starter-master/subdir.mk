@@ -13,6 +13,9 @@
 #       make testN.v    (runs valgrind on testN and puts output in testN.v)
 #       make valgrind   (makes all testN.v files, i.e. runs valgrind on all tests)
 #
+#       make bench      (runs all benchmarks and prints a table of their results,
+#                        BENCHFLAGS="pages=64 frames=16" changes the workload)
+#
 #       make clean      (removes all files created by this Makefile)
 
 # sh is dash on lectura which breaks things
@@ -38,6 +41,9 @@ SRCS = $(wildcard *.c)
 # Tests are in the "tests" directory.
 TESTS = $(patsubst %.c,%,$(wildcard tests/*.c))
 
+# Benchmarks are in the "bench" directory.
+BENCHES = $(patsubst %.c,%,$(wildcard bench/*.c))
+
 # Change this if you want to change the arguments to valgrind.
 VGFLAGS = --track-origins=yes --leak-check=full --max-stackframe=100000
 
@@ -74,6 +80,9 @@ CFLAGS += -Wall -g -std=gnu99 -Werror -DPHASE=$(PHASE_UPPER) -D$(PHASE_UPPER) -D
 
 #CFLAGS += -DDEBUG
 
+# Uncomment to record tracepoints in a ring buffer, decoded by tools/tpdump (phase3Trace.h).
+#CFLAGS += -DP3_TRACEPOINTS
+
 # You shouldn't need to change anything below here. 
 
 TARGET = lib$(PHASE)-$(VERSION).a
@@ -104,6 +113,9 @@ TOBJS = ${TESTS:=.o}
 TDEPS = ${TOBJS:.o=.d}
 TOUTS = ${TESTS:=.out}
 TVS = ${TESTS:=.v}
+BOBJS = ${BENCHES:=.o}
+BDEPS = ${BOBJS:.o=.d}
+BOUTS = ${BENCHES:=.bench}
 
 # The following is to deal with circular dependencies between the USLOSS and phase1
 # libraries. Unfortunately the linkers handle this differently on the two OSes.
@@ -114,7 +126,7 @@ else
 	LIBFLAGS = -Wl,--start-group $(LIBS) -Wl,--end-group
 endif
 
-.PHONY: $(PHASE) tests
+.PHONY: $(PHASE) tests bench
 
 %.d: %.c
 	$(CC) -c $(CFLAGS) -MM -MF $@ $<
@@ -140,8 +152,20 @@ tests: $(TOUTS)
 $(TESTS):   %: $(TARGET) %.o $(STUBS)
 	$(LD) $(LDFLAGS) -o $@ $@.o $(STUBS) $(LIBFLAGS)
 
+.NOTPARALLEL: bench
+bench: $(BOUTS)
+	@printf "%-10s %8s %8s %8s %8s %8s %10s\n" workload faults newPages pageIns pageOuts replaced "time(us)"
+	@$(if $(BOUTS),grep -h '^BENCH ' $(BOUTS) | cut -c7-)
+
+%.bench: %
+	./$< $(BENCHFLAGS) 1> $@ 2>&1
+
+$(BENCHES): %: $(TARGET) %.o $(STUBS)
+	$(LD) $(LDFLAGS) -o $@ $@.o $(STUBS) $(LIBFLAGS)
+
 clean:
 	rm -f $(COBJS) $(TARGET) $(TOBJS) $(TESTS) $(DEPS) $(TDEPS) $(TVS) *.out tests/*.out tests/*.err
+	rm -f $(BOBJS) $(BENCHES) $(BDEPS) $(BOUTS)
 
 %.d: %.c
 	$(CC) -c $(CFLAGS) -MM -MF $@ $<
@@ -156,3 +180,4 @@ valgrind: $(TVS)
 
 -include $(DEPS) 
 -include $(TDEPS)
+-include $(BDEPS)
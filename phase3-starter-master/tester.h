@@ -56,7 +56,13 @@ static char *errors[] = {
     "Invalid frame.",
     "Invalid page.",
     "Access violation.",
-    "Not implemented."
+    "Not implemented.",
+    "Invalid shared region.",
+    "Too many shared regions.",
+    "Invalid swap units.",
+    "Invalid VM options.",
+    "Too many pinned pages.",
+    "Invalid disk mapping."
 };
 
 static int numCodes = sizeof(errors) / sizeof(char *);
@@ -0,0 +1,264 @@
+/*
+ * replay.c
+ *
+ *  Replays a fault trace recorded by the pager (phase3Trace.h) against several page
+ *  replacement policies and numbers of frames, and prints the fault rate of each:
+ *
+ *      OPT     Belady's optimal, evicts the page that is used again furthest in the future
+ *      LRU     evicts the least recently used page
+ *      CLOCK   the pager's clock, one reference bit per frame
+ *      FIFO    evicts the page that was brought in first
+ *
+ *  Every record in the trace is a reference to (pid, page). Like the pager, replacement is
+ *  global across processes and free frames are used before anything is evicted.
+ *
+ *  usage: replay [-f min frames] [-F max frames] [-s step] trace
+ *
+ *  The frames default to 1 up to the number of distinct pages in the trace, in about 20
+ *  steps.
+ *
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "phase3Trace.h"
+
+#define OPT     0
+#define LRU     1
+#define CLOCK   2
+#define FIFO    3
+#define POLICIES 4
+
+static char *policyNames[POLICIES] = {"OPT", "LRU", "CLOCK", "FIFO"};
+
+static int  numRefs;        // # of references in the trace
+static int  numIds;         // # of distinct (pid, page)
+static int  *refs;          // page id of each reference
+static int  *nextUse;       // index of the next reference to the same page, numRefs if none
+
+// per frame
+static int  *frameId;       // page in the frame, -1 if free
+static int  *frameStamp;    // LRU: last use, FIFO: when it was loaded
+static int  *frameRef;      // CLOCK: reference bit
+static int  *frameNext;     // OPT: next use of the page
+static int  *idFrame;       // frame each page is in, -1 if none
+
+static long long
+Key(P3_TraceRecord *record)
+{
+    return ((long long) record->pid << 32) | (unsigned int) record->page;
+}
+
+static int
+KeyCompare(const void *a, const void *b)
+{
+    long long x = *(long long *) a;
+    long long y = *(long long *) b;
+
+    return (x > y) - (x < y);
+}
+
+/*
+ * Reads the trace and turns it into a string of page ids, numbered 0 .. numIds - 1, and
+ * works out each reference's next use for OPT.
+ */
+static void
+Load(char *path)
+{
+    P3_TraceRecord  record;
+    long long       *keys, *sorted, *found;
+    int             *last;
+    FILE            *file;
+    int             size = 1024;
+    int             i;
+
+    file = fopen(path, "rb");
+    if (file == NULL) {
+        perror(path);
+        exit(1);
+    }
+    keys = (long long *) malloc(size * sizeof(long long));
+    numRefs = 0;
+    while (fread(&record, sizeof(record), 1, file) == 1) {
+        if (numRefs == size) {
+            size *= 2;
+            keys = (long long *) realloc(keys, size * sizeof(long long));
+        }
+        keys[numRefs++] = Key(&record);
+    }
+    fclose(file);
+
+    sorted = (long long *) malloc((numRefs + 1) * sizeof(long long));
+    memcpy(sorted, keys, numRefs * sizeof(long long));
+    qsort(sorted, numRefs, sizeof(long long), KeyCompare);
+    numIds = 0;
+    for (i = 0; i < numRefs; i++) {
+        if ((numIds == 0) || (sorted[i] != sorted[numIds - 1])) {
+            sorted[numIds++] = sorted[i];
+        }
+    }
+    refs = (int *) malloc((numRefs + 1) * sizeof(int));
+    for (i = 0; i < numRefs; i++) {
+        found = bsearch(&keys[i], sorted, numIds, sizeof(long long), KeyCompare);
+        assert(found != NULL);
+        refs[i] = found - sorted;
+    }
+
+    nextUse = (int *) malloc((numRefs + 1) * sizeof(int));
+    last = (int *) malloc((numIds + 1) * sizeof(int));
+    for (i = 0; i < numIds; i++) {
+        last[i] = numRefs;
+    }
+    for (i = numRefs - 1; i >= 0; i--) {
+        nextUse[i] = last[refs[i]];
+        last[refs[i]] = i;
+    }
+    free(keys);
+    free(sorted);
+    free(last);
+}
+
+// the frame to evict, all frames are in use
+static int
+Victim(int policy, int frames, int *hand)
+{
+    int victim = 0;
+    int i;
+
+    switch (policy) {
+    case OPT:
+        for (i = 1; i < frames; i++) {
+            if (frameNext[i] > frameNext[victim]) {
+                victim = i;
+            }
+        }
+        break;
+    case LRU:
+    case FIFO:
+        for (i = 1; i < frames; i++) {
+            if (frameStamp[i] < frameStamp[victim]) {
+                victim = i;
+            }
+        }
+        break;
+    case CLOCK:
+        while (1) {
+            *hand = (*hand + 1) % frames;
+            if (!frameRef[*hand]) {
+                break;
+            }
+            frameRef[*hand] = 0;
+        }
+        victim = *hand;
+        break;
+    }
+    return victim;
+}
+
+// returns the number of faults the policy has on the trace with the given frames
+static int
+Simulate(int policy, int frames)
+{
+    int faults = 0;
+    int used = 0;
+    int hand = -1;
+    int frame;
+    int i;
+
+    for (i = 0; i < frames; i++) {
+        frameId[i] = -1;
+    }
+    for (i = 0; i < numIds; i++) {
+        idFrame[i] = -1;
+    }
+    for (i = 0; i < numRefs; i++) {
+        frame = idFrame[refs[i]];
+        if (frame == -1) {
+            faults++;
+            if (used < frames) {
+                frame = used++;
+            } else {
+                frame = Victim(policy, frames, &hand);
+                idFrame[frameId[frame]] = -1;
+            }
+            frameId[frame] = refs[i];
+            idFrame[refs[i]] = frame;
+            frameStamp[frame] = i;
+        } else if (policy == LRU) {
+            frameStamp[frame] = i;
+        }
+        frameRef[frame] = 1;
+        frameNext[frame] = nextUse[i];
+    }
+    return faults;
+}
+
+static void
+Usage(char *name)
+{
+    fprintf(stderr, "usage: %s [-f min frames] [-F max frames] [-s step] trace\n", name);
+    exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+    int minFrames = 1, maxFrames = 0, step = 0;
+    int frames, policy, faults;
+    int c;
+
+    while ((c = getopt(argc, argv, "f:F:s:")) != -1) {
+        switch (c) {
+        case 'f':
+            minFrames = atoi(optarg);
+            break;
+        case 'F':
+            maxFrames = atoi(optarg);
+            break;
+        case 's':
+            step = atoi(optarg);
+            break;
+        default:
+            Usage(argv[0]);
+        }
+    }
+    if ((optind != argc - 1) || (minFrames < 1)) {
+        Usage(argv[0]);
+    }
+    Load(argv[optind]);
+    if (numRefs == 0) {
+        printf("%s: empty trace\n", argv[optind]);
+        return 0;
+    }
+    if (maxFrames < minFrames) {
+        maxFrames = numIds > minFrames ? numIds : minFrames;
+    }
+    if (step < 1) {
+        step = (maxFrames - minFrames) / 20 > 1 ? (maxFrames - minFrames) / 20 : 1;
+    }
+    frameId = (int *) malloc(maxFrames * sizeof(int));
+    frameStamp = (int *) malloc(maxFrames * sizeof(int));
+    frameRef = (int *) malloc(maxFrames * sizeof(int));
+    frameNext = (int *) malloc(maxFrames * sizeof(int));
+    idFrame = (int *) malloc(numIds * sizeof(int));
+
+    printf("%s: %d references to %d pages, fault rate (%%) by frames\n", argv[optind],
+           numRefs, numIds);
+    printf("%8s", "frames");
+    for (policy = 0; policy < POLICIES; policy++) {
+        printf(" %8s", policyNames[policy]);
+    }
+    printf("\n");
+    for (frames = minFrames; frames <= maxFrames; frames += step) {
+        printf("%8d", frames);
+        for (policy = 0; policy < POLICIES; policy++) {
+            faults = Simulate(policy, frames);
+            printf(" %8.2f", 100.0 * faults / numRefs);
+        }
+        printf("\n");
+    }
+    return 0;
+}
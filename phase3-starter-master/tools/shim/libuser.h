@@ -0,0 +1,9 @@
+/*
+ * libuser.h
+ *
+ *  Host-side stand-in, the frame and swap code only needs it to exist.
+ */
+#ifndef _LIBUSER_H
+#define _LIBUSER_H
+
+#endif
@@ -0,0 +1,34 @@
+/*
+ * phase1.h
+ *
+ *  Host-side stand-in for the phase 1 processes, locks and condition variables, on top of
+ *  pthreads (see shim.c).
+ */
+#ifndef _PHASE1_H
+#define _PHASE1_H
+
+#include <usloss.h>
+
+#define TRUE            1
+#define FALSE           0
+
+#define P1_MAXPROC      50
+#define P1_MAXNAME      80
+#define P1_MAXLOCKS     100
+#define P1_MAXCONDS     100
+
+#define P1_SUCCESS      0
+#define P1_INVALID_PID  -15
+
+int     P1_Fork(char *name, int (*func)(void *), void *arg, int stacksize, int priority,
+                int tag, int *pid);
+int     P1_GetPid(void);
+int     P1_LockCreate(char *name, int *lid);
+int     P1_Lock(int lid);
+int     P1_Unlock(int lid);
+int     P1_CondCreate(char *name, int lid, int *vid);
+int     P1_Wait(int vid);
+int     P1_Signal(int vid);
+int     P1_Broadcast(int vid);
+
+#endif
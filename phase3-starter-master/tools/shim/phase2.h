@@ -0,0 +1,15 @@
+/*
+ * phase2.h
+ *
+ *  Host-side stand-in for the phase 2 disk and sleep calls, the disks are kept in memory
+ *  (see shim.c).
+ */
+#ifndef _PHASE2_H
+#define _PHASE2_H
+
+int     P2_DiskRead(int unit, int first, int sectors, void *buffer);
+int     P2_DiskWrite(int unit, int first, int sectors, void *buffer);
+int     P2_DiskSize(int unit, int *sector, int *disk);
+int     P2_Sleep(int seconds);
+
+#endif
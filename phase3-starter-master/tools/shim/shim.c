@@ -0,0 +1,263 @@
+/*
+ * shim.c
+ *
+ *  Host-side implementation of the USLOSS, phase 1 and phase 2 calls the frame and swap
+ *  code (phase3b.c, phase3c.c) makes, so it can be built natively and profiled. Processes
+ *  are threads, locks and condition variables are pthread mutexes and conditions, the
+ *  disks are arrays in memory, and the MMU is just physical memory and an access word
+ *  per frame.
+ */
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <usloss.h>
+#include <phase1.h>
+#include <phase2.h>
+
+#define PAGE_SIZE   4096
+
+static char     *pmAddr;
+static int      numPages;
+static int      numFrames;
+static int      *accessBits;    // USLOSS_MMU_REF and USLOSS_MMU_DIRTY bits of each frame
+
+static char     *disks[USLOSS_DISK_UNITS];
+static int      diskSectors[USLOSS_DISK_UNITS];
+
+static pthread_mutex_t  locks[P1_MAXLOCKS];
+static int              numLocks;
+static pthread_cond_t   conds[P1_MAXCONDS];
+static int              condLock[P1_MAXCONDS];
+static int              numConds;
+
+static int              numProcs = 1;   // pid 0 is the thread that called ShimInit
+static __thread int     myPid;
+
+typedef struct Proc {
+    int     (*func)(void *);
+    void    *arg;
+    int     pid;
+} Proc;
+
+/*
+ * Sets up physical memory and a disk of tracks tracks on every unit. Call it before
+ * P3FrameInit and P3SwapInit.
+ */
+void
+ShimInit(int pages, int frames, int tracks)
+{
+    int i;
+
+    numPages = pages;
+    numFrames = frames;
+    pmAddr = (char *) calloc(frames, PAGE_SIZE);
+    accessBits = (int *) calloc(frames, sizeof(int));
+    for (i = 0; i < USLOSS_DISK_UNITS; i++) {
+        diskSectors[i] = tracks * USLOSS_DISK_TRACK_SIZE;
+        disks[i] = (char *) calloc(diskSectors[i], USLOSS_DISK_SECTOR_SIZE);
+    }
+}
+
+// what the MMU does when a mapped page is referenced
+void
+ShimAccess(int frame, int write)
+{
+    accessBits[frame] |= USLOSS_MMU_REF | (write ? USLOSS_MMU_DIRTY : 0);
+}
+
+void
+USLOSS_Console(char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    vprintf(fmt, ap);
+    va_end(ap);
+}
+
+void
+USLOSS_VConsole(char *fmt, va_list ap)
+{
+    vprintf(fmt, ap);
+}
+
+void
+USLOSS_Halt(int status)
+{
+    exit(status);
+}
+
+int
+USLOSS_Clock(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int) (now.tv_sec * 1000000 + now.tv_nsec / 1000);
+}
+
+int
+USLOSS_MmuGetConfig(void **vmRegion, void **pm, int *pageSize, int *pages, int *frames,
+                    int *mode)
+{
+    *vmRegion = NULL;
+    *pm = pmAddr;
+    *pageSize = PAGE_SIZE;
+    *pages = numPages;
+    *frames = numFrames;
+    *mode = USLOSS_MMU_MODE_PAGETABLE;
+    return USLOSS_MMU_OK;
+}
+
+int
+USLOSS_MmuGetAccess(int frame, int *bits)
+{
+    assert((frame >= 0) && (frame < numFrames));
+    *bits = accessBits[frame];
+    return USLOSS_MMU_OK;
+}
+
+int
+USLOSS_MmuSetAccess(int frame, int bits)
+{
+    assert((frame >= 0) && (frame < numFrames));
+    accessBits[frame] = bits;
+    return USLOSS_MMU_OK;
+}
+
+int
+USLOSS_MmuPageSize(void)
+{
+    return PAGE_SIZE;
+}
+
+static void *
+ProcStart(void *arg)
+{
+    Proc    *proc = (Proc *) arg;
+
+    myPid = proc->pid;
+    proc->func(proc->arg);
+    free(proc);
+    return NULL;
+}
+
+int
+P1_Fork(char *name, int (*func)(void *), void *arg, int stacksize, int priority, int tag,
+        int *pid)
+{
+    Proc        *proc = (Proc *) malloc(sizeof(Proc));
+    pthread_t   thread;
+    int         rc;
+
+    proc->func = func;
+    proc->arg = arg;
+    proc->pid = __sync_fetch_and_add(&numProcs, 1);
+    *pid = proc->pid;
+    rc = pthread_create(&thread, NULL, ProcStart, proc);
+    assert(rc == 0);
+    rc = pthread_detach(thread);
+    assert(rc == 0);
+    return P1_SUCCESS;
+}
+
+int
+P1_GetPid(void)
+{
+    return myPid;
+}
+
+int
+P1_LockCreate(char *name, int *lid)
+{
+    assert(numLocks < P1_MAXLOCKS);
+    pthread_mutex_init(&locks[numLocks], NULL);
+    *lid = numLocks++;
+    return P1_SUCCESS;
+}
+
+int
+P1_Lock(int lid)
+{
+    pthread_mutex_lock(&locks[lid]);
+    return P1_SUCCESS;
+}
+
+int
+P1_Unlock(int lid)
+{
+    pthread_mutex_unlock(&locks[lid]);
+    return P1_SUCCESS;
+}
+
+int
+P1_CondCreate(char *name, int lid, int *vid)
+{
+    assert(numConds < P1_MAXCONDS);
+    pthread_cond_init(&conds[numConds], NULL);
+    condLock[numConds] = lid;
+    *vid = numConds++;
+    return P1_SUCCESS;
+}
+
+int
+P1_Wait(int vid)
+{
+    pthread_cond_wait(&conds[vid], &locks[condLock[vid]]);
+    return P1_SUCCESS;
+}
+
+int
+P1_Signal(int vid)
+{
+    pthread_cond_signal(&conds[vid]);
+    return P1_SUCCESS;
+}
+
+int
+P1_Broadcast(int vid)
+{
+    pthread_cond_broadcast(&conds[vid]);
+    return P1_SUCCESS;
+}
+
+int
+P2_DiskRead(int unit, int first, int sectors, void *buffer)
+{
+    assert((unit >= 0) && (unit < USLOSS_DISK_UNITS));
+    assert((first >= 0) && (first + sectors <= diskSectors[unit]));
+    memcpy(buffer, disks[unit] + first * USLOSS_DISK_SECTOR_SIZE,
+           sectors * USLOSS_DISK_SECTOR_SIZE);
+    return P1_SUCCESS;
+}
+
+int
+P2_DiskWrite(int unit, int first, int sectors, void *buffer)
+{
+    assert((unit >= 0) && (unit < USLOSS_DISK_UNITS));
+    assert((first >= 0) && (first + sectors <= diskSectors[unit]));
+    memcpy(disks[unit] + first * USLOSS_DISK_SECTOR_SIZE, buffer,
+           sectors * USLOSS_DISK_SECTOR_SIZE);
+    return P1_SUCCESS;
+}
+
+int
+P2_DiskSize(int unit, int *sector, int *disk)
+{
+    assert((unit >= 0) && (unit < USLOSS_DISK_UNITS));
+    *sector = USLOSS_DISK_SECTOR_SIZE;
+    *disk = diskSectors[unit];
+    return P1_SUCCESS;
+}
+
+int
+P2_Sleep(int seconds)
+{
+    sleep(seconds);
+    return P1_SUCCESS;
+}
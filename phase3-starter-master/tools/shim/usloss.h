@@ -0,0 +1,46 @@
+/*
+ * usloss.h
+ *
+ *  Host-side stand-in for the parts of USLOSS the frame and swap code uses, so it can be
+ *  built natively (see shim.c). Physical memory is a malloc'd array and the reference and
+ *  dirty bits are set by the caller (ShimAccess) instead of the hardware.
+ */
+#ifndef _USLOSS_H
+#define _USLOSS_H
+
+#include <stdarg.h>
+
+#define USLOSS_MIN_STACK            8192
+#define USLOSS_DISK_SECTOR_SIZE     512
+#define USLOSS_DISK_TRACK_SIZE      16
+#define USLOSS_DISK_UNITS           2
+
+#define USLOSS_MMU_OK               0
+#define USLOSS_MMU_FAULT            1
+#define USLOSS_MMU_ACCESS           2
+#define USLOSS_MMU_REF              1
+#define USLOSS_MMU_DIRTY            2
+#define USLOSS_MMU_MODE_PAGETABLE   1
+
+typedef struct USLOSS_PTE {
+    unsigned int    incore:1;
+    unsigned int    read:1;
+    unsigned int    write:1;
+    unsigned int    frame:20;
+} USLOSS_PTE;
+
+void    USLOSS_Console(char *fmt, ...);
+void    USLOSS_VConsole(char *fmt, va_list ap);
+void    USLOSS_Halt(int status);
+int     USLOSS_Clock(void);
+int     USLOSS_MmuGetConfig(void **vmRegion, void **pmAddr, int *pageSize, int *numPages,
+                            int *numFrames, int *mode);
+int     USLOSS_MmuGetAccess(int frame, int *access);
+int     USLOSS_MmuSetAccess(int frame, int access);
+int     USLOSS_MmuPageSize(void);
+
+// shim only
+void    ShimInit(int pages, int frames, int tracks);
+void    ShimAccess(int frame, int write);
+
+#endif
@@ -0,0 +1,74 @@
+/*
+ * tpdump.c
+ *
+ *  Decodes the tracepoint ring written when the phase is compiled with -DP3_TRACEPOINTS
+ *  (phase3Trace.h), one line per record, oldest first:
+ *
+ *      time event pid page frame unit arg
+ *
+ *  Fields that don't apply to the event are printed as "-".
+ *
+ *  usage: tpdump [file]
+ *
+ *  The file defaults to P3_TP_FILE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "phase3Trace.h"
+
+static char *eventNames[P3_TP_EVENTS] = {
+    "enqueue", "dequeue", "wakeup", "victim", "swapRead", "swapWrite", "newPage", "cow",
+    "fill", "move", "merge", "prefetch", "deactivate", "softFault",
+};
+
+static void
+Field(int value)
+{
+    if (value == -1) {
+        printf(" %8s", "-");
+    } else {
+        printf(" %8d", value);
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    P3_TpRecord record;
+    char        *path = P3_TP_FILE;
+    FILE        *file;
+    int         count = 0;
+
+    if (argc > 2) {
+        fprintf(stderr, "usage: %s [file]\n", argv[0]);
+        exit(1);
+    }
+    if (argc == 2) {
+        path = argv[1];
+    }
+    file = fopen(path, "rb");
+    if (file == NULL) {
+        perror(path);
+        exit(1);
+    }
+    printf("%10s %-9s %8s %8s %8s %8s %8s\n", "time", "event", "pid", "page", "frame", "unit",
+           "arg");
+    while (fread(&record, sizeof(record), 1, file) == 1) {
+        if (record.event < P3_TP_EVENTS) {
+            printf("%10u %-9s", record.time, eventNames[record.event]);
+        } else {
+            printf("%10u %-9d", record.time, record.event);
+        }
+        Field(record.pid);
+        Field(record.page);
+        Field(record.frame);
+        Field(record.unit);
+        Field(record.arg);
+        printf("\n");
+        count++;
+    }
+    fclose(file);
+    printf("%d records\n", count);
+    return 0;
+}
@@ -0,0 +1,318 @@
+/*
+ * vmbench.c
+ *
+ *  Native microbenchmark for the frame and swap code (phase3b.c, phase3c.c), built on the
+ *  host against the USLOSS shim in shim/ instead of the USLOSS and phase 1/2 libraries.
+ *  It takes the place of phase3a: it keeps the page tables, drives millions of synthetic
+ *  references from several processes through them, resolves the faults with
+ *  P3PageFaultResolve, and sets the reference and dirty bits the MMU would. The swap disk
+ *  is in memory, so the times are those of the bookkeeping itself: the frame table, the
+ *  swap map, the block allocator and the clock.
+ *
+ *  Every written page holds its (pid, page) stamp, which is checked on every reference,
+ *  so a bookkeeping bug shows up as a failed assertion rather than just a wrong number.
+ *
+ *  usage: vmbench [-p pages] [-P processes] [-f frames] [-n references] [-w write %]
+ *                 [-u swap units mask] [-s seed] [-l frame limit] [-m map unit]
+ *                 [-i inactive %] [-z | -c]
+ *
+ *  -z picks pages from a Zipfian distribution instead of uniformly, and -c has each process
+ *  loop over its pages in order, the case where the clock evicts the pages about to be
+ *  used again if they don't quite fit. -l limits process 1 to that many frames
+ *  (P3FrameLimitSet), and the pages replaced for each process are printed so the effect on
+ *  the others can be seen. -m maps every process's pages to blocks of that disk unit, which
+ *  must not be a swap unit (P3MapCreate), each block stamped with its page beforehand. -i
+ *  keeps that % of the frames on the inactive list (P3_inactivePercent), none by default.
+ *
+ *  make perf and make cachegrind in this directory run it under perf and cachegrind.
+ */
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <usloss.h>
+#include <phase1.h>
+#include <phase2.h>
+
+#include "phase3.h"
+#include "phase3Int.h"
+
+P3_VmStats  P3_vmStats;
+int         P3_swapUnits = 1 << P3_SWAP_DISK;
+char        *P3_faultTrace = NULL;
+P3_ProcStats    P3_procStats[P1_MAXPROC];
+
+static int          numPages = 64;
+static int          numProcs = 8;
+static int          numFrames = 128;
+static long         numRefs = 2000000;
+static int          writePercent = 30;
+static int          zipf = FALSE;
+static int          loop = FALSE;
+static int          cursor[P1_MAXPROC];     // -c: the page each process touches next
+static int          frameLimit = 0;
+static int          mapUnit = -1;
+static unsigned     seed = 1;
+
+static USLOSS_PTE       *pageTables[P1_MAXPROC];
+static char             *written[P1_MAXPROC];   // TRUE if the page has been written
+static int              pending[P1_MAXPROC];    // page whose swap I/O is outstanding, -1 if none
+static pthread_mutex_t  vmLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   faultDone = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t   frameIdle = PTHREAD_COND_INITIALIZER;
+static double           *cdf;                   // Zipf: probability of a page <= i
+
+static long
+Now(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+int
+P3PageTableGet(PID pid, USLOSS_PTE **table)
+{
+    if ((pid < 0) || (pid >= P1_MAXPROC)) {
+        return P1_INVALID_PID;
+    }
+    *table = pageTables[pid];
+    return P1_SUCCESS;
+}
+
+void
+P3VmLock(void)
+{
+    pthread_mutex_lock(&vmLock);
+}
+
+void
+P3VmUnlock(void)
+{
+    pthread_mutex_unlock(&vmLock);
+}
+
+void
+P3PageFaultDone(PID pid, int page, int frame)
+{
+    if (pending[pid] != page) {
+        return;
+    }
+    pageTables[pid][page].incore = 1;
+    pageTables[pid][page].read = 1;
+    pageTables[pid][page].write = 1;
+    pageTables[pid][page].frame = frame;
+    pending[pid] = -1;
+    pthread_cond_broadcast(&faultDone);
+}
+
+void
+P3FrameIdle(void)
+{
+    pthread_cond_broadcast(&frameIdle);
+}
+
+// no zeroer here, every new page is zeroed during its fault
+void
+P3FrameFreed(void)
+{
+}
+
+// does what the pager does for a fault, returns once the page is mapped
+static void
+Fault(int pid, int page)
+{
+    int frame;
+    int rc;
+
+    P3VmLock();
+    P3_vmStats.faults++;
+    while ((rc = P3PageFaultResolve(pid, page, &frame)) == P3_FRAMES_BUSY) {
+        pthread_cond_wait(&frameIdle, &vmLock);
+    }
+    if (rc == P3_IO_PENDING) {
+        pending[pid] = page;
+        while (pending[pid] != -1) {
+            pthread_cond_wait(&faultDone, &vmLock);
+        }
+    } else if (rc == P1_SUCCESS) {
+        pageTables[pid][page].incore = 1;
+        pageTables[pid][page].read = 1;
+        pageTables[pid][page].write = 1;
+        pageTables[pid][page].frame = frame;
+    } else {
+        fprintf(stderr, "vmbench: fault on page %d of %d failed: %d\n", page, pid, rc);
+        exit(1);
+    }
+    P3VmUnlock();
+}
+
+static int
+NextPage(int pid)
+{
+    double  u;
+    int     low = 0, high = numPages - 1, mid;
+
+    if (loop) {
+        cursor[pid] = (cursor[pid] + 1) % numPages;
+        return cursor[pid];
+    }
+    if (!zipf) {
+        return rand_r(&seed) % numPages;
+    }
+    u = (double) rand_r(&seed) / RAND_MAX;
+    while (low < high) {
+        mid = (low + high) / 2;
+        if (cdf[mid] < u) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+static void
+Usage(char *name)
+{
+    fprintf(stderr, "usage: %s [-p pages] [-P processes] [-f frames] [-n references] "
+            "[-w write %%] [-u swap units mask] [-s seed] [-l frame limit] [-m map unit] "
+            "[-i inactive %%] [-z | -c]\n", name);
+    exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+    USLOSS_PTE  *table;
+    void        *vmRegion, *pmAddr;
+    int         *words;
+    int         pid, page, write;
+    int         pageSize, pages, frames, mode;
+    long        ref, faults = 0;
+    long        start, faultStart, faultTime = 0, total;
+    double      sum = 0.0;
+    int         c, i, rc;
+
+    while ((c = getopt(argc, argv, "p:P:f:n:w:u:s:l:m:i:zc")) != -1) {
+        switch (c) {
+        case 'p': numPages = atoi(optarg); break;
+        case 'P': numProcs = atoi(optarg); break;
+        case 'f': numFrames = atoi(optarg); break;
+        case 'n': numRefs = atol(optarg); break;
+        case 'w': writePercent = atoi(optarg); break;
+        case 'u': P3_swapUnits = atoi(optarg); break;
+        case 's': seed = atoi(optarg); break;
+        case 'l': frameLimit = atoi(optarg); break;
+        case 'm': mapUnit = atoi(optarg); break;
+        case 'i': P3_inactivePercent = atoi(optarg); break;
+        case 'z': zipf = TRUE; break;
+        case 'c': loop = TRUE; break;
+        default: Usage(argv[0]);
+        }
+    }
+    if ((numPages < 1) || (numProcs < 1) || (numProcs >= P1_MAXPROC) || (numFrames < 1)) {
+        Usage(argv[0]);
+    }
+
+    cdf = (double *) malloc(numPages * sizeof(double));
+    for (i = 0; i < numPages; i++) {
+        sum += 1.0 / (i + 1);
+        cdf[i] = sum;
+    }
+    for (i = 0; i < numPages; i++) {
+        cdf[i] /= sum;
+    }
+
+    // room for every page on each unit
+    ShimInit(numPages, numFrames, numProcs * numPages * USLOSS_MmuPageSize()
+             / (USLOSS_DISK_TRACK_SIZE * USLOSS_DISK_SECTOR_SIZE) + 1);
+    P3_vmStats.pages = numPages;
+    P3_vmStats.frames = numFrames;
+    rc = P3FrameInit(numPages, numFrames);
+    assert(rc == P1_SUCCESS);
+    rc = P3SwapInit(numPages, numFrames);
+    assert(rc == P1_SUCCESS);
+    rc = USLOSS_MmuGetConfig(&vmRegion, &pmAddr, &pageSize, &pages, &frames, &mode);
+    assert(rc == USLOSS_MMU_OK);
+    for (pid = 1; pid <= numProcs; pid++) {
+        pageTables[pid] = (USLOSS_PTE *) calloc(numPages, sizeof(USLOSS_PTE));
+        written[pid] = (char *) calloc(numPages, 1);
+        pending[pid] = -1;
+    }
+    rc = P3FrameLimitSet(1, frameLimit);
+    assert(rc == P1_SUCCESS);
+    if (mapUnit != -1) {
+        words = (int *) calloc(pageSize, 1);
+        for (pid = 1; pid <= numProcs; pid++) {
+            for (page = 0; page < numPages; page++) {
+                words[0] = pid;
+                words[1] = page;
+                rc = P2_DiskWrite(mapUnit, ((pid - 1) * numPages + page) * pageSize
+                                  / USLOSS_DISK_SECTOR_SIZE, pageSize / USLOSS_DISK_SECTOR_SIZE,
+                                  words);
+                assert(rc == P1_SUCCESS);
+                written[pid][page] = TRUE;
+            }
+            rc = P3MapCreate(pid, 0, numPages, mapUnit, (pid - 1) * numPages);
+            if (rc != P1_SUCCESS) {
+                fprintf(stderr, "vmbench: can't map unit %d: %d\n", mapUnit, rc);
+                exit(1);
+            }
+        }
+        free(words);
+    }
+
+    start = Now();
+    for (ref = 0; ref < numRefs; ref++) {
+        pid = 1 + rand_r(&seed) % numProcs;
+        page = NextPage(pid);
+        write = (rand_r(&seed) % 100) < writePercent;
+        table = pageTables[pid];
+        if (!table[page].incore) {
+            faultStart = Now();
+            Fault(pid, page);
+            faultTime += Now() - faultStart;
+            faults++;
+        }
+        ShimAccess(table[page].frame, write);
+        words = (int *) ((char *) pmAddr + table[page].frame * pageSize);
+        if (written[pid][page]) {
+            assert((words[0] == pid) && (words[1] == page));
+        }
+        if (write) {
+            words[0] = pid;
+            words[1] = page;
+            written[pid][page] = TRUE;
+        }
+    }
+    total = Now() - start;
+    P3SwapShutdown();
+
+    printf("%ld references, %d processes x %d pages, %d frames, %s, %d%% writes\n",
+           numRefs, numProcs, numPages, numFrames, zipf ? "zipf" : loop ? "loop" : "uniform",
+           writePercent);
+    printf("faults %ld newPages %d pageIns %d pageOuts %d replaced %d fillPages %d\n",
+           faults, P3_vmStats.newPages, P3_vmStats.pageIns, P3_vmStats.pageOuts,
+           P3_vmStats.replaced, P3_vmStats.fillPages);
+    printf("%.1f ns/reference, %.1f ns/fault\n", (double) total / numRefs,
+           faults > 0 ? (double) faultTime / faults : 0.0);
+    printf("softFaults %d hardFaults %d refaults %d\n", P3_vmStats.softFaults,
+           P3_vmStats.hardFaults, P3_vmStats.refaults);
+    if (mapUnit != -1) {
+        printf("%d pages mapped to unit %d\n", P3_vmStats.mappedPages, mapUnit);
+    }
+    if (frameLimit > 0) {
+        printf("replaced by process:");
+        for (pid = 1; pid <= numProcs; pid++) {
+            printf(" %d", P3_procStats[pid].replaced);
+        }
+        printf("\n");
+    }
+    return 0;
+}